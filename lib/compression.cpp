@@ -0,0 +1,151 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+
+#include <zlib.h>
+
+namespace tasktracker {
+
+namespace {
+
+std::string_view
+trim(std::string_view str)
+{
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str[0]))) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() &&
+           std::isspace(static_cast<unsigned char>(str.back()))) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+bool
+equals_ignore_case(std::string_view a, std::string_view b)
+{
+    return std::equal(
+      a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+          return std::tolower(static_cast<unsigned char>(x)) ==
+                 std::tolower(static_cast<unsigned char>(y));
+      });
+}
+
+/// @brief check that the parameters of a coding in Accept-Encoding, e.g.
+/// ";q=0.5", don't rule it out
+bool
+is_acceptable(std::string_view params)
+{
+    while (!params.empty()) {
+        const auto end = params.find(';');
+        const auto param = trim(params.substr(0, end));
+        params = end == std::string_view::npos ? std::string_view()
+                                               : params.substr(end + 1);
+
+        if (param.size() < 2 || !equals_ignore_case(param.substr(0, 2), "q=")) {
+            continue;
+        }
+        // q is at most three decimals, so only q=0, q=0.0 etc. reject.
+        const auto value = param.substr(2);
+        return value.find_first_not_of("0.") != std::string_view::npos;
+    }
+    return true;
+}
+
+} // namespace
+
+ContentEncoding
+choose_content_encoding(std::string_view accept_encoding)
+{
+    // Unset until a coding is listed, so "*" only applies to the others and
+    // "gzip;q=0, *" still refuses gzip.
+    std::optional<bool> gzip;
+    std::optional<bool> deflate;
+    std::optional<bool> any;
+
+    while (!accept_encoding.empty()) {
+        const auto end = accept_encoding.find(',');
+        const auto item = accept_encoding.substr(0, end);
+        accept_encoding = end == std::string_view::npos
+                            ? std::string_view()
+                            : accept_encoding.substr(end + 1);
+
+        const auto params = item.find(';');
+        const auto name = trim(item.substr(0, params));
+        const bool acceptable = params == std::string_view::npos ||
+                                is_acceptable(item.substr(params));
+
+        if (equals_ignore_case(name, "gzip") ||
+            equals_ignore_case(name, "x-gzip")) {
+            gzip = gzip.value_or(false) || acceptable;
+        } else if (equals_ignore_case(name, "deflate")) {
+            deflate = deflate.value_or(false) || acceptable;
+        } else if (name == "*") {
+            any = any.value_or(false) || acceptable;
+        }
+    }
+
+    if (gzip.value_or(any.value_or(false))) {
+        return ContentEncoding::Gzip;
+    }
+    if (deflate.value_or(any.value_or(false))) {
+        return ContentEncoding::Deflate;
+    }
+    return ContentEncoding::Identity;
+}
+
+std::string_view
+content_encoding_name(ContentEncoding encoding)
+{
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            return "gzip";
+        case ContentEncoding::Deflate:
+            return "deflate";
+        case ContentEncoding::Identity:
+            break;
+    }
+    return "identity";
+}
+
+std::optional<std::string>
+compress(std::string_view data, ContentEncoding encoding, int level)
+{
+    if (encoding == ContentEncoding::Identity) {
+        return std::nullopt;
+    }
+
+    z_stream stream{};
+    // 15 bits of window for the zlib format, +16 for a gzip wrapper.
+    const int window_bits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream,
+                     std::clamp(level, 0, 9),
+                     Z_DEFLATED,
+                     window_bits,
+                     8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return std::nullopt;
+    }
+
+    std::string result;
+    result.resize(deflateBound(&stream, data.size()));
+
+    stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = result.size();
+
+    const int ret = deflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (ret != Z_STREAM_END) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace tasktracker
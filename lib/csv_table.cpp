@@ -0,0 +1,76 @@
+#include "csv_table.h"
+
+#include <charconv>
+
+namespace tasktracker {
+
+CsvTable::CsvTable(std::string text, bool has_header)
+  : m_text(std::make_unique<const std::string>(std::move(text)))
+{
+    std::string_view rest = *m_text;
+    bool header = has_header;
+
+    while (!rest.empty()) {
+        const auto end = rest.find('\n');
+        auto line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view()
+                                             : rest.substr(end + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (header) {
+            header = false;
+            continue;
+        }
+
+        size_t start = 0;
+        size_t comma = 0;
+        while ((comma = line.find(',', start)) != std::string_view::npos) {
+            m_fields.push_back(line.substr(start, comma - start));
+            start = comma + 1;
+        }
+        m_fields.push_back(line.substr(start));
+        m_row_start.push_back(m_fields.size());
+    }
+}
+
+size_t
+CsvTable::rows() const
+{
+    return m_row_start.size() - 1;
+}
+
+std::span<const std::string_view>
+CsvTable::row(size_t index) const
+{
+    return { m_fields.data() + m_row_start[index],
+             m_row_start[index + 1] - m_row_start[index] };
+}
+
+std::optional<double>
+parse_number(std::string_view field)
+{
+    while (!field.empty() && field.front() == ' ') {
+        field.remove_prefix(1);
+    }
+    while (!field.empty() && field.back() == ' ') {
+        field.remove_suffix(1);
+    }
+    if (!field.empty() && field.front() == '+') {
+        field.remove_prefix(1);
+    }
+
+    double value = 0;
+    const auto res =
+      std::from_chars(field.data(), field.data() + field.size(), value);
+    if (res.ec != std::errc() || res.ptr != field.data() + field.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace tasktracker
@@ -1,8 +1,12 @@
 #include "database_driver.h"
+#include "metrics.h"
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <iostream>
 #include <sstream>
+#include <string_view>
 
 #define TASK_ID "ID"
 #define TASK_NAME "TASKNAME"
@@ -16,9 +20,71 @@
 #define PARENT_ID "PARENT_ID"
 #define FINISH_TIME "FINISHTIME"
 #define STATE "STATE"
+#define ROW_ID "ROW_ID"
+#define CHANGE_NUM "CHANGENUM"
+#define SETTING_KEY "KEY"
+#define SETTING_VALUE "VALUE"
 
 namespace tasktracker {
 
+namespace {
+
+/// @brief Statement timings by the first keyword of the statement. Every
+/// sqlite3_exec is one sample, so statements that are counted must be
+/// executed one at a time.
+struct StatementMetrics
+{
+    static constexpr const char* operations[] = {
+        "select", "insert", "update", "delete", "create", "drop",
+        "begin",  "commit", "pragma", "other"
+    };
+
+    std::array<MetricHistogram*, std::size(operations)> durations;
+    MetricCounter* errors;
+
+    StatementMetrics()
+    {
+        auto& metrics = Metrics::instance();
+        for (size_t i = 0; i < durations.size(); ++i) {
+            durations[i] = &metrics.histogram(
+              "tasktracker_db_statement_seconds",
+              "Time spent executing SQL statements by operation.",
+              std::string("operation=\"") + operations[i] + "\"");
+        }
+        errors = &metrics.counter("tasktracker_db_errors_total",
+                                  "SQL statements that failed.");
+    }
+
+    MetricHistogram& duration(const std::string& statement)
+    {
+        const auto begin = statement.find_first_not_of(" \n");
+        for (size_t i = 0; i + 1 < durations.size(); ++i) {
+            const std::string_view op = operations[i];
+            if (begin != std::string::npos &&
+                statement.size() - begin >= op.size() &&
+                std::equal(op.begin(),
+                           op.end(),
+                           statement.begin() + begin,
+                           [](char a, char b) {
+                               return a == std::tolower(
+                                             static_cast<unsigned char>(b));
+                           })) {
+                return *durations[i];
+            }
+        }
+        return *durations.back();
+    }
+};
+
+StatementMetrics&
+statement_metrics()
+{
+    static StatementMetrics metrics;
+    return metrics;
+}
+
+} // namespace
+
 std::string
 num_to_string(auto num)
 {
@@ -42,6 +108,36 @@ get_id_cb(void* data, int argc, char** argv, char** column)
     return 0;
 }
 
+static int
+s_get_int64_cb(void* data, int argc, char** argv, char** column)
+{
+    (void)column;
+    long long* value = static_cast<long long*>(data);
+
+    for (int i = 0; i < argc; ++i) {
+        if (argv[i] != 0) {
+            std::stringstream(argv[i]) >> *value;
+        }
+    }
+
+    return 0;
+}
+
+static int
+s_get_ids_cb(void* data, int argc, char** argv, char** column)
+{
+    (void)column;
+    auto ids = static_cast<std::vector<int>*>(data);
+
+    if (argc > 0 && argv[0] != 0) {
+        int id = 0;
+        std::stringstream(argv[0]) >> id;
+        ids->push_back(id);
+    }
+
+    return 0;
+}
+
 static int
 s_get_task_cb(void* data, int argc, char** argv, char** column)
 {
@@ -158,7 +254,15 @@ DatabaseDriver::DatabaseDriver(std::filesystem::path path,
                                std::string table_name)
   : m_path(path)
   , m_table(table_name)
+  , m_change_table(table_name + "_CHANGES")
+{
+}
+
+DatabaseDriver::~DatabaseDriver()
 {
+    if (m_version_db) {
+        sqlite3_close(m_version_db);
+    }
 }
 
 void
@@ -171,22 +275,121 @@ void
 DatabaseDriver::clear()
 {
     m_open_db();
-    auto str = "DROP TABLE " + m_table + ";";
+    // Delete the rows first so the deletions reach the change log and other
+    // processes watching the database see them.
+    auto str = "DELETE FROM " + m_table + "; DROP TABLE " + m_table + ";";
     m_execute(str);
     m_close_db();
     m_make_table();
 }
 
+int
+DatabaseDriver::data_version()
+{
+    if (!m_version_db &&
+        sqlite3_open(m_path.c_str(), &m_version_db) != SQLITE_OK) {
+        throw DatabaseErr("Database " + m_path.string() + " didn't open.");
+    }
+
+    int version = 0;
+    char* err = nullptr;
+    int ern = sqlite3_exec(
+      m_version_db, "PRAGMA data_version;", get_id_cb, &version, &err);
+
+    if (ern != SQLITE_OK) {
+        auto exept = DatabaseErr(std::string("Reading data_version failed: ") +
+                                 (err ? err : ""));
+        sqlite3_free(err);
+        throw exept;
+    }
+    return version;
+}
+
+long long
+DatabaseDriver::last_change()
+{
+    long long change = 0;
+    m_open_db();
+    m_execute("SELECT IFNULL(MAX(" CHANGE_NUM "), 0) FROM " + m_change_table +
+                ";",
+              &change,
+              s_get_int64_cb);
+    m_close_db();
+    return change;
+}
+
+void
+DatabaseDriver::begin_transaction()
+{
+    if (m_in_transaction) {
+        throw DatabaseErr("Transaction already started on " + m_table + ".");
+    }
+    m_open_db();
+    m_execute("BEGIN;");
+    m_in_transaction = true;
+}
+
+void
+DatabaseDriver::commit()
+{
+    m_execute("COMMIT;");
+    m_in_transaction = false;
+    m_close_db();
+}
+
+void
+DatabaseDriver::rollback() noexcept
+{
+    if (!m_in_transaction) {
+        return;
+    }
+    sqlite3_exec(m_db, "ROLLBACK;", NULL, NULL, NULL);
+    m_in_transaction = false;
+    m_close_db();
+}
+
+void
+DatabaseDriver::m_make_change_log()
+{
+    // Every insert, update and delete on m_table stores the row's rowid in
+    // m_change_table with a new change number, so changes made by any
+    // process can be read back in order without scanning m_table.
+    const std::string next_change =
+      "(SELECT IFNULL(MAX(" CHANGE_NUM "), 0) + 1 FROM " + m_change_table + ")";
+    std::string str = "CREATE TABLE IF NOT EXISTS " + m_change_table +
+                      "(" ROW_ID " INTEGER PRIMARY KEY, " CHANGE_NUM
+                      " INTEGER);"
+                      "CREATE INDEX IF NOT EXISTS " +
+                      m_change_table + "_IDX ON " + m_change_table +
+                      "(" CHANGE_NUM ");";
+
+    for (const auto& [event, row] : { std::pair{ "INSERT", "NEW" },
+                                      std::pair{ "UPDATE", "NEW" },
+                                      std::pair{ "DELETE", "OLD" } }) {
+        str += std::string("CREATE TRIGGER IF NOT EXISTS ") + m_table + "_" +
+               event + "_LOG AFTER " + event + " ON " + m_table +
+               " BEGIN INSERT OR REPLACE INTO " + m_change_table +
+               " VALUES(" + row + ".rowid, " + next_change + "); END;";
+    }
+    m_execute(str);
+}
+
 void
 DatabaseDriver::m_execute(const std::string& statement,
                           void* return_value,
                           int (*callback)(void*, int, char**, char**))
 {
     char* err = nullptr;
-    int ern =
-      sqlite3_exec(m_db, statement.c_str(), callback, return_value, &err);
+    int ern = SQLITE_OK;
+    {
+        const ScopedMetricTimer timer(
+          statement_metrics().duration(statement));
+        ern =
+          sqlite3_exec(m_db, statement.c_str(), callback, return_value, &err);
+    }
 
     if (ern != SQLITE_OK) {
+        statement_metrics().errors->add();
         auto exept =
           DatabaseErr("Executing statement\n" + statement + "\nfailed: " + err);
         m_close_db();
@@ -198,6 +401,9 @@ DatabaseDriver::m_execute(const std::string& statement,
 void
 DatabaseDriver::m_open_db()
 {
+    if (m_in_transaction) {
+        return;
+    }
     if (sqlite3_open(m_path.c_str(), &m_db) != SQLITE_OK) {
         throw DatabaseErr("Database " + m_path.string() + " didn't open.");
     }
@@ -206,7 +412,7 @@ DatabaseDriver::m_open_db()
 void
 DatabaseDriver::m_close_db()
 {
-    if (m_db) {
+    if (m_db && !m_in_transaction) {
         sqlite3_close(m_db);
     }
 }
@@ -235,6 +441,7 @@ TaskDatabase::m_make_table()
 
     // clang-format on
     m_execute(str);
+    m_make_change_log();
     m_close_db();
 }
 
@@ -318,6 +525,41 @@ TaskDatabase::get_task(int id)
     return nullptr;
 }
 
+std::vector<std::unique_ptr<TaskData>>
+TaskDatabase::get_tasks_changed(long long since, long long until)
+{
+    std::string query = "SELECT T.* FROM " + m_table + " T JOIN " +
+                        m_change_table + " C ON T.rowid = C." ROW_ID
+                        " WHERE C." CHANGE_NUM " > " +
+                        num_to_string(since) + " AND C." CHANGE_NUM " <= " +
+                        num_to_string(until) + ";";
+    std::vector<std::unique_ptr<TaskData>> result;
+
+    m_open_db();
+    m_execute(query, &result, s_get_task_cb);
+    m_close_db();
+
+    return result;
+}
+
+std::vector<int>
+TaskDatabase::get_deleted_tasks(long long since, long long until)
+{
+    std::string query = "SELECT C." ROW_ID " FROM " + m_change_table +
+                        " C LEFT JOIN " + m_table +
+                        " T ON T.rowid = C." ROW_ID " WHERE C." CHANGE_NUM
+                        " > " +
+                        num_to_string(since) + " AND C." CHANGE_NUM " <= " +
+                        num_to_string(until) + " AND T.rowid IS NULL;";
+    std::vector<int> result;
+
+    m_open_db();
+    m_execute(query, &result, s_get_ids_cb);
+    m_close_db();
+
+    return result;
+}
+
 TaskInstanceDatabase::TaskInstanceDatabase(std::filesystem::path path)
   : DatabaseDriver(path, TASK_INSTANCES_TABLE_NAME)
 {
@@ -336,6 +578,37 @@ TaskInstanceDatabase::create_task(const int& parent_task,
     m_close_db();
 }
 
+void
+TaskInstanceDatabase::create_tasks(
+  const std::vector<TaskInstanceData>& tasks) noexcept(false)
+{
+    if (tasks.empty()) {
+        return;
+    }
+
+    // One execution per statement, so the statement metrics count every
+    // insert. The transaction keeps it a single write to the disk.
+    begin_transaction();
+    try {
+        for (const auto& task : tasks) {
+            m_execute(
+              "INSERT OR IGNORE INTO " + m_table + " VALUES('" +
+              escape_quote(task.id) + "', '" + num_to_string(task.parent_id) +
+              "', '" + escape_quote(task.name) + "', '" +
+              num_to_string(task.scheduled_start) + "', '" +
+              num_to_string(task.start_time) + "', '" +
+              num_to_string(task.finish_time) + "', '" +
+              num_to_string(task.time_spent.count()) + "', '" +
+              escape_quote(task.comment) + "', '" +
+              num_to_string(static_cast<int>(task.state)) + "');");
+        }
+        commit();
+    } catch (...) {
+        rollback();
+        throw;
+    }
+}
+
 void
 TaskInstanceDatabase::update_task(const TaskInstanceData* task) noexcept(false)
 {
@@ -412,6 +685,56 @@ TaskInstanceDatabase::get_task(const std::string& id) noexcept(false)
     return nullptr;
 }
 
+std::vector<std::unique_ptr<TaskInstanceData>>
+TaskInstanceDatabase::get_tasks_in_range(time_t from,
+                                         time_t to,
+                                         std::optional<TaskState> state,
+                                         const TaskInstanceData* after,
+                                         size_t limit) noexcept(false)
+{
+    std::string query = "SELECT * FROM " + m_table +
+                        " WHERE " TASK_BEGINNING " >= " + num_to_string(from) +
+                        " AND " TASK_BEGINNING " < " + num_to_string(to);
+
+    if (state) {
+        query += " AND IFNULL(" TASK_STATE ", 0) = " +
+                 num_to_string(static_cast<int>(*state));
+    }
+    if (after) {
+        query += " AND (" TASK_BEGINNING ", " TASK_ID ") > (" +
+                 num_to_string(after->scheduled_start) + ", '" +
+                 escape_quote(after->id) + "')";
+    }
+    query += " ORDER BY " TASK_BEGINNING ", " TASK_ID " LIMIT " +
+             num_to_string(limit) + ";";
+
+    std::vector<std::unique_ptr<TaskInstanceData>> result;
+
+    m_open_db();
+    m_execute(query, &result, s_get_task_instance_cb);
+    m_close_db();
+
+    return result;
+}
+
+std::vector<std::unique_ptr<TaskInstanceData>>
+TaskInstanceDatabase::get_tasks_changed(long long since,
+                                        long long until) noexcept(false)
+{
+    std::string query = "SELECT T.* FROM " + m_table + " T JOIN " +
+                        m_change_table + " C ON T.rowid = C." ROW_ID
+                        " WHERE C." CHANGE_NUM " > " +
+                        num_to_string(since) + " AND C." CHANGE_NUM " <= " +
+                        num_to_string(until) + ";";
+    std::vector<std::unique_ptr<TaskInstanceData>> result;
+
+    m_open_db();
+    m_execute(query, &result, s_get_task_instance_cb);
+    m_close_db();
+
+    return result;
+}
+
 void
 TaskInstanceDatabase::m_make_table()
 {
@@ -429,6 +752,58 @@ TaskInstanceDatabase::m_make_table()
       TIME_SPENT "      INTEGER, "
       TASK_COMMENT "    TEXT, "
       TASK_STATE "      INTEGER"
+      ");"
+      "CREATE INDEX IF NOT EXISTS " + m_table + "_BEGINNING_IDX ON " +
+      m_table + "(" TASK_BEGINNING ", " TASK_ID ");";
+
+    // clang-format on
+    m_execute(str);
+    m_make_change_log();
+    m_close_db();
+}
+
+SettingsDatabase::SettingsDatabase(std::filesystem::path path)
+  : DatabaseDriver(path, SETTINGS_TABLE_NAME)
+{
+}
+
+long long
+SettingsDatabase::get_value(const std::string& key,
+                            long long default_value) noexcept(false)
+{
+    long long value = default_value;
+    std::string query = "SELECT " SETTING_VALUE " FROM " + m_table +
+                        " WHERE " SETTING_KEY "='" + escape_quote(key) + "';";
+
+    m_open_db();
+    m_execute(query, &value, s_get_int64_cb);
+    m_close_db();
+
+    return value;
+}
+
+void
+SettingsDatabase::set_value(const std::string& key,
+                            long long value) noexcept(false)
+{
+    std::string str = "INSERT OR REPLACE INTO " + m_table + " VALUES('" +
+                      escape_quote(key) + "', " + num_to_string(value) + ");";
+
+    m_open_db();
+    m_execute(str);
+    m_close_db();
+}
+
+void
+SettingsDatabase::m_make_table()
+{
+    m_open_db();
+    // clang-format off
+    const std::string str =
+      "CREATE TABLE IF NOT EXISTS " + m_table +
+      "("
+      SETTING_KEY "   TEXT PRIMARY KEY, "
+      SETTING_VALUE " INTEGER"
       ");";
 
     // clang-format on
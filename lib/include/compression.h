@@ -0,0 +1,60 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace tasktracker {
+
+/// @brief HTTP content codings supported for responses.
+enum class ContentEncoding
+{
+    Identity,
+    Deflate,
+    Gzip
+};
+
+/// @brief Pick the content coding for a response from the Accept-Encoding
+/// header of the request. gzip is preferred over deflate when both are
+/// acceptable; codings with q=0 are never picked.
+/// @param accept_encoding value of the Accept-Encoding header
+/// @return the coding to use, Identity if nothing supported is accepted
+ContentEncoding choose_content_encoding(std::string_view accept_encoding);
+
+/// @brief get the name of the coding for the Content-Encoding header.
+std::string_view content_encoding_name(ContentEncoding encoding);
+
+/// @brief Compress data with zlib.
+/// @param data data to compress
+/// @param encoding Gzip or Deflate; deflate means the zlib format as
+/// specified for HTTP
+/// @param level zlib compression level, 0-9
+/// @return compressed data, or std::nullopt if zlib failed or encoding is
+/// Identity
+std::optional<std::string> compress(std::string_view data,
+                                    ContentEncoding encoding,
+                                    int level);
+
+} // namespace tasktracker
+
+#endif /* COMPRESSION_H */
@@ -0,0 +1,69 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef CSV_TABLE_H
+#define CSV_TABLE_H
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tasktracker {
+
+/// @brief Comma separated values split in a single pass. The fields are
+/// views into the text, which the table owns, so nothing is copied.
+/// Quoting isn't supported.
+class CsvTable
+{
+  public:
+    CsvTable() = default;
+
+    /// @brief Split text into rows and fields. Empty lines and a trailing
+    /// carriage return are ignored.
+    /// @param text the CSV text
+    /// @param has_header skip the first line
+    explicit CsvTable(std::string text, bool has_header = true);
+
+    /// @brief get the number of rows, not counting the header
+    size_t rows() const;
+
+    /// @brief get the fields of a row
+    /// @param index row index, must be less than rows()
+    std::span<const std::string_view> row(size_t index) const;
+
+  private:
+    /// @brief on the heap so moving the table doesn't move the text the
+    /// fields point to
+    std::unique_ptr<const std::string> m_text;
+    std::vector<std::string_view> m_fields;
+    /// @brief index of the first field of each row in m_fields, followed
+    /// by the total number of fields
+    std::vector<size_t> m_row_start{ 0 };
+};
+
+/// @brief Parse a field as a number.
+/// @return the number, or std::nullopt if the field isn't one
+std::optional<double> parse_number(std::string_view field);
+
+} // namespace tasktracker
+
+#endif /* CSV_TABLE_H */
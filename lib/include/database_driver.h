@@ -25,6 +25,7 @@
 #include <exception>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -34,6 +35,7 @@ namespace tasktracker {
 
 const std::string TASKS_TABLE_NAME = "TASKS";
 const std::string TASK_INSTANCES_TABLE_NAME = "TASKINSTANCES";
+const std::string SETTINGS_TABLE_NAME = "SETTINGS";
 
 class DatabaseErr : public std::exception
 {
@@ -52,15 +54,44 @@ class DatabaseDriver
 {
   public:
     explicit DatabaseDriver(std::filesystem::path path, std::string table_name);
-    virtual ~DatabaseDriver(){};
+    virtual ~DatabaseDriver();
     void init() noexcept(false);
 
     /// @brief Clear the whole task database.
     /// @throws DatabaseErr on exception.
     void clear() noexcept(false);
 
+    /// @brief Read PRAGMA data_version through a connection that is kept
+    /// open, so the value changes whenever any other connection (including
+    /// other processes) commits to the database file.
+    /// @return the current data version
+    /// @throws DatabaseErr on exception.
+    int data_version() noexcept(false);
+
+    /// @brief get the newest change number recorded for the table. Every
+    /// insert, update and delete on the table gets a new, larger number.
+    /// @return newest change number, 0 if the table was never modified.
+    /// @throws DatabaseErr on exception.
+    long long last_change() noexcept(false);
+
+    /// @brief Start a transaction. Until commit or rollback is called, all
+    /// statements run on one connection inside the transaction. Transactions
+    /// can't be nested.
+    /// @throws DatabaseErr on exception.
+    void begin_transaction() noexcept(false);
+
+    /// @brief Commit the transaction started with begin_transaction.
+    /// @throws DatabaseErr on exception.
+    void commit() noexcept(false);
+
+    /// @brief Roll back the transaction started with begin_transaction.
+    void rollback() noexcept;
+
   protected:
     virtual void m_make_table() noexcept(false){};
+    /// @brief Create the change log table and triggers for m_table.
+    /// Must be called with the database open.
+    void m_make_change_log() noexcept(false);
     void m_open_db() noexcept(false);
     void m_close_db() noexcept(false);
     void m_execute(
@@ -70,7 +101,10 @@ class DatabaseDriver
 
     const std::filesystem::path m_path;
     sqlite3* m_db{ nullptr };
+    sqlite3* m_version_db{ nullptr };
+    bool m_in_transaction{ false };
     const std::string m_table;
+    const std::string m_change_table;
 };
 
 /// @brief Interraction handler with Task SQL database for Task data,
@@ -84,7 +118,12 @@ class TaskDatabase : protected DatabaseDriver
     /// @throws DatabaseErr on exception.
     explicit TaskDatabase(std::filesystem::path path) noexcept(false);
     ~TaskDatabase(){};
+    using DatabaseDriver::begin_transaction;
+    using DatabaseDriver::commit;
+    using DatabaseDriver::data_version;
     using DatabaseDriver::init;
+    using DatabaseDriver::last_change;
+    using DatabaseDriver::rollback;
 
     /// @brief Create a new task
     /// @param task name of the task
@@ -117,6 +156,23 @@ class TaskDatabase : protected DatabaseDriver
     /// @throws DatabaseErr on exception.
     std::unique_ptr<TaskData> get_task(int id) noexcept(false);
 
+    /// @brief get tasks inserted or updated after a change number.
+    /// @param since only changes newer than this are returned
+    /// @param until only changes up to this are returned
+    /// @return changed tasks that still exist
+    /// @throws DatabaseErr on exception.
+    std::vector<std::unique_ptr<TaskData>> get_tasks_changed(
+      long long since,
+      long long until) noexcept(false);
+
+    /// @brief get IDs of tasks deleted after a change number.
+    /// @param since only changes newer than this are returned
+    /// @param until only changes up to this are returned
+    /// @return IDs of the deleted tasks
+    /// @throws DatabaseErr on exception.
+    std::vector<int> get_deleted_tasks(long long since,
+                                       long long until) noexcept(false);
+
   private:
     void m_make_table() override;
 };
@@ -137,6 +193,7 @@ class TaskInstanceDatabase : protected DatabaseDriver
 
     using DatabaseDriver::clear;
     using DatabaseDriver::init;
+    using DatabaseDriver::last_change;
 
     /// @brief Create a new TaskInstance
     /// @param parent_task
@@ -147,6 +204,13 @@ class TaskInstanceDatabase : protected DatabaseDriver
                      const std::string& uid,
                      const std::string& name) noexcept(false);
 
+    /// @brief Create many TaskInstances in a single transaction. Instances
+    /// whose ID already exists are left untouched.
+    /// @param tasks the TaskInstanceData to store
+    /// @throws DatabaseErr on exception.
+    void create_tasks(const std::vector<TaskInstanceData>& tasks) noexcept(
+      false);
+
     /// @brief update the database with TaskInstanceData data
     /// @param task pointer to the TaskData to be updated. task->id must exist
     /// @throws DatabaseErr on exception.
@@ -173,6 +237,66 @@ class TaskInstanceDatabase : protected DatabaseDriver
     std::unique_ptr<TaskInstanceData> get_task(const std::string& id) noexcept(
       false);
 
+    /// @brief get TaskInstanceData scheduled in a time range, ordered by the
+    /// scheduled start and ID. Large ranges can be read page by page by
+    /// passing the last item of the previous page as after.
+    /// @param from only tasks scheduled at or after this are returned
+    /// @param to only tasks scheduled before this are returned
+    /// @param state if set, only tasks in this state are returned
+    /// @param after if not null, only tasks ordered after this are returned
+    /// @param limit maximum number of tasks to return
+    /// @return matching TaskInstanceData
+    /// @throws DatabaseErr on exception.
+    std::vector<std::unique_ptr<TaskInstanceData>> get_tasks_in_range(
+      time_t from,
+      time_t to,
+      std::optional<TaskState> state,
+      const TaskInstanceData* after,
+      size_t limit) noexcept(false);
+
+    /// @brief get TaskInstanceData inserted or updated after a change number.
+    /// @param since only changes newer than this are returned
+    /// @param until only changes up to this are returned
+    /// @return changed TaskInstanceData
+    /// @throws DatabaseErr on exception.
+    std::vector<std::unique_ptr<TaskInstanceData>> get_tasks_changed(
+      long long since,
+      long long until) noexcept(false);
+
+  private:
+    void m_make_table() override;
+};
+
+/// @brief Interraction handler with SQL database for integer settings and
+/// state that has to survive restarts, e.g. the last processed day.
+class SettingsDatabase : protected DatabaseDriver
+{
+  public:
+    /// @brief Create a new SettingsDatabase item with databasefile found
+    /// in path.
+    // if the database file isn't found, it's created.
+    /// @param path path to the database.
+    /// @throws DatabaseErr on exception.
+    explicit SettingsDatabase(std::filesystem::path path) noexcept(false);
+    ~SettingsDatabase(){};
+
+    using DatabaseDriver::clear;
+    using DatabaseDriver::init;
+
+    /// @brief get a stored value
+    /// @param key name of the value
+    /// @param default_value returned if the value isn't stored
+    /// @return the stored value or default_value
+    /// @throws DatabaseErr on exception.
+    long long get_value(const std::string& key,
+                        long long default_value = 0) noexcept(false);
+
+    /// @brief store a value, replacing the old one
+    /// @param key name of the value
+    /// @param value the value
+    /// @throws DatabaseErr on exception.
+    void set_value(const std::string& key, long long value) noexcept(false);
+
   private:
     void m_make_table() override;
 };
@@ -0,0 +1,188 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+
+namespace tasktracker {
+
+/// @brief Append-only JSON writer serializing straight into a buffer.
+/// Nothing is allocated besides the buffer growing, so a buffer reserved
+/// for the expected size is written without allocations. The caller is
+/// responsible for calling the methods in an order that forms valid JSON.
+/// @tparam Buffer byte buffer with append(const char*, size) and
+/// push_back(char), e.g. std::string or QByteArray
+template<typename Buffer>
+class JsonWriter
+{
+  public:
+    /// @brief Create a writer appending to buffer.
+    explicit JsonWriter(Buffer& buffer)
+      : m_buffer(buffer)
+    {
+    }
+
+    JsonWriter& begin_array()
+    {
+        m_separate();
+        m_buffer.push_back('[');
+        m_need_comma = false;
+        return *this;
+    }
+
+    JsonWriter& end_array()
+    {
+        m_buffer.push_back(']');
+        m_need_comma = true;
+        return *this;
+    }
+
+    JsonWriter& begin_object()
+    {
+        m_separate();
+        m_buffer.push_back('{');
+        m_need_comma = false;
+        return *this;
+    }
+
+    JsonWriter& end_object()
+    {
+        m_buffer.push_back('}');
+        m_need_comma = true;
+        return *this;
+    }
+
+    /// @brief Write the key of the next object member.
+    JsonWriter& key(std::string_view name)
+    {
+        m_separate();
+        m_write_string(name);
+        m_buffer.push_back(':');
+        m_need_comma = false;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view str)
+    {
+        m_separate();
+        m_write_string(str);
+        m_need_comma = true;
+        return *this;
+    }
+
+    JsonWriter& value(const char* str)
+    {
+        return value(std::string_view(str));
+    }
+
+    template<typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    JsonWriter& value(T number)
+    {
+        char digits[24];
+        const auto res =
+          std::to_chars(digits, digits + sizeof(digits), number);
+
+        m_separate();
+        m_buffer.append(digits, res.ptr - digits);
+        m_need_comma = true;
+        return *this;
+    }
+
+    JsonWriter& value(bool boolean)
+    {
+        m_separate();
+        if (boolean) {
+            m_buffer.append("true", 4);
+        } else {
+            m_buffer.append("false", 5);
+        }
+        m_need_comma = true;
+        return *this;
+    }
+
+    /// @brief Write a key and its value.
+    template<typename T>
+    JsonWriter& member(std::string_view name, const T& val)
+    {
+        return key(name).value(val);
+    }
+
+  private:
+    Buffer& m_buffer;
+    bool m_need_comma{ false };
+
+    void m_separate()
+    {
+        if (m_need_comma) {
+            m_buffer.push_back(',');
+        }
+    }
+
+    void m_write_string(std::string_view str)
+    {
+        static const char hex[] = "0123456789abcdef";
+        size_t run = 0;
+
+        m_buffer.push_back('"');
+        // Copy runs of characters that need no escaping in one go.
+        for (size_t i = 0; i < str.size(); ++i) {
+            const unsigned char c = str[i];
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            m_buffer.append(str.data() + run, i - run);
+            run = i + 1;
+
+            switch (c) {
+                case '"':
+                    m_buffer.append("\\\"", 2);
+                    break;
+                case '\\':
+                    m_buffer.append("\\\\", 2);
+                    break;
+                case '\n':
+                    m_buffer.append("\\n", 2);
+                    break;
+                case '\r':
+                    m_buffer.append("\\r", 2);
+                    break;
+                case '\t':
+                    m_buffer.append("\\t", 2);
+                    break;
+                default: {
+                    const char escape[] = {
+                        '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]
+                    };
+                    m_buffer.append(escape, sizeof(escape));
+                }
+            }
+        }
+        m_buffer.append(str.data() + run, str.size() - run);
+        m_buffer.push_back('"');
+    }
+};
+
+} // namespace tasktracker
+
+#endif /* JSON_WRITER_H */
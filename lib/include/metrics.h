@@ -0,0 +1,141 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tasktracker {
+
+/// @brief Number of shards a metric is split into. Each thread updates its
+/// own shard, so threads don't contend on the same cache line.
+const size_t METRIC_SHARDS = 8;
+
+/// @brief Monotonically increasing counter. Updating is lock-free.
+class MetricCounter
+{
+  public:
+    void add(uint64_t value = 1);
+    uint64_t value() const;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{ 0 };
+    };
+    std::array<Shard, METRIC_SHARDS> m_shards;
+};
+
+/// @brief Histogram of observed values, e.g. durations in seconds.
+/// Observing is lock-free.
+class MetricHistogram
+{
+  public:
+    /// @brief Create a histogram.
+    /// @param bounds upper bounds of the buckets in increasing order. A
+    /// bucket for everything larger is added.
+    explicit MetricHistogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    struct Snapshot
+    {
+        std::vector<double> bounds;
+        /// @brief cumulative count per bound, the last one is +Inf
+        std::vector<uint64_t> counts;
+        double sum;
+    };
+    Snapshot snapshot() const;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+        std::atomic<double> sum{ 0 };
+    };
+    const std::vector<double> m_bounds;
+    std::array<Shard, METRIC_SHARDS> m_shards;
+};
+
+/// @brief Observes the time from construction to destruction in seconds.
+class ScopedMetricTimer
+{
+  public:
+    explicit ScopedMetricTimer(MetricHistogram& histogram);
+    ~ScopedMetricTimer();
+
+  private:
+    MetricHistogram& m_histogram;
+    const std::chrono::steady_clock::time_point m_start;
+};
+
+/// @brief Process wide registry of metrics. Looking a metric up takes a
+/// lock, so look it up once and keep the reference; updating it doesn't.
+class Metrics
+{
+  public:
+    static Metrics& instance();
+
+    /// @brief get a counter, creating it on first use.
+    /// @param name metric name, e.g. tasktracker_requests_total
+    /// @param help description written on the HELP line; only the one
+    /// given when the metric family is first created is used
+    /// @param labels labels in Prometheus syntax without braces, e.g.
+    /// route="/task",method="GET"
+    /// @return the counter, valid until the program exits
+    MetricCounter& counter(const std::string& name,
+                           const std::string& help,
+                           const std::string& labels = "");
+
+    /// @brief get a histogram, creating it on first use. Parameters as in
+    /// counter.
+    /// @param bounds bucket bounds used if the histogram is created, by
+    /// default suitable for durations in seconds
+    MetricHistogram& histogram(const std::string& name,
+                               const std::string& help,
+                               const std::string& labels = "",
+                               std::vector<double> bounds = {});
+
+    /// @brief Write all metrics in the Prometheus text format.
+    /// @param out the text is appended to this
+    void write(std::string& out) const;
+
+  private:
+    struct Family
+    {
+        std::string help;
+        std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+        std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family> m_families;
+};
+
+} // namespace tasktracker
+
+#endif /* METRICS_H */
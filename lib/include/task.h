@@ -20,6 +20,9 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <functional>
+#include <optional>
+
 #include "database_driver.h"
 
 namespace tasktracker {
@@ -80,6 +83,11 @@ class TaskInstance
     /// @return pointer to TaskInstanceData
     const TaskInstanceData* get_data() const;
 
+    /// @brief Replace the data with a copy read from the database, e.g.
+    /// after another process modified it. Doesn't write to the database.
+    /// @param data the new data
+    void reload(const TaskInstanceData& data);
+
     /// @brief Check if task is finished
     /// @return true if finished
     bool is_finished() const;
@@ -92,9 +100,17 @@ class TaskInstance
     /// @return true if started
     bool is_started() const;
 
+    /// @brief Set a function called after the state is changed with
+    /// start_task, skip_task, finish_task or set_undone.
+    /// @param cb the function, or nullptr to remove it
+    void set_state_changed_cb(std::function<void(const TaskInstance&)> cb);
+
   private:
     std::unique_ptr<TaskInstanceData> m_data;
     TaskInstanceDatabase* m_db;
+    std::function<void(const TaskInstance&)> m_state_changed_cb;
+
+    void m_set_state(TaskState state);
 };
 
 class Task
@@ -133,7 +149,15 @@ class Task
     bool occurs(tm day);
     bool occurs(std::chrono::year_month_day day);
 
+    /// @brief Find the first day the Task occurs on, starting from a day.
+    /// Computed directly from the repeat rule without testing every day.
+    /// @param from the first day to consider
+    /// @return the day, or std::nullopt if the Task never occurs again.
+    std::optional<std::chrono::year_month_day> next_occurrence(
+      std::chrono::year_month_day from) const;
+
     TaskData* get_data() { return m_data; };
+    const TaskData* get_data() const { return m_data; };
 
   private:
     TaskData* m_data;
@@ -66,6 +66,8 @@ struct TaskData
     RepeatType repeat_type;
     /// @brief info of repeating, handled according to repeat_type
     int repeat_info;
+
+    bool operator==(const TaskData&) const = default;
 };
 
 enum TaskState
@@ -97,6 +99,8 @@ struct TaskInstanceData
     std::string comment;
     /// @brief state of the task.
     TaskState state;
+
+    bool operator==(const TaskInstanceData&) const = default;
 };
 
 } // namespace tasktracker
@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef TASK_SNAPSHOT_H
+#define TASK_SNAPSHOT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "task_data.h"
+
+namespace tasktracker {
+
+/// @brief Version of the snapshot file format. Snapshots with another
+/// version are ignored.
+const uint32_t TASK_SNAPSHOT_VERSION = 1;
+
+/// @brief Write tasks into a binary snapshot file. The file is written next
+/// to path and renamed over it, so a reader never sees a partial snapshot.
+/// @param path path of the snapshot file
+/// @param change change number of the task table the tasks were read at
+/// @param tasks the tasks to write
+/// @return true if the snapshot was written
+bool write_task_snapshot(const std::filesystem::path& path,
+                         long long change,
+                         const std::vector<const TaskData*>& tasks);
+
+/// @brief Read tasks from a binary snapshot file by memory mapping it.
+/// @param path path of the snapshot file
+/// @param change current change number of the task table
+/// @return the tasks, or std::nullopt if the file is missing, corrupt, of
+/// another version or was written at another change number.
+std::optional<std::vector<std::unique_ptr<TaskData>>> read_task_snapshot(
+  const std::filesystem::path& path,
+  long long change);
+
+} // namespace tasktracker
+
+#endif /* TASK_SNAPSHOT_H */
@@ -20,7 +20,10 @@
 #ifndef TASKTRACKLIB_H
 #define TASKTRACKLIB_H
 
+#include <functional>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "database_driver.h"
 #include "task.h"
@@ -28,6 +31,53 @@
 
 namespace tasktracker {
 
+/// @brief A single future occurrence of a Task.
+struct Occurrence
+{
+    Task* task;
+    /// @brief date and time the occurrence is scheduled to start
+    time_t scheduled_start;
+};
+
+/// @brief Number of change records TaskTracker keeps.
+const size_t CHANGE_LOG_CAPACITY = 1024;
+
+/// @brief Kind of a ChangeRecord.
+enum class ChangeType
+{
+    TaskCreated,
+    TaskUpdated,
+    TaskDeleted,
+    InstanceStateChanged,
+    /// @brief everything may have changed, e.g. the tracker was cleared
+    Reset
+};
+
+/// @brief A change made through the tracker or picked up by sync.
+struct ChangeRecord
+{
+    /// @brief position in the change log, increases by one per record
+    uint64_t sequence;
+    /// @brief generation of the task definitions after the change
+    uint64_t generation;
+    ChangeType type;
+    /// @brief ID of the changed task, or of the parent task of the instance
+    int task_id;
+    /// @brief ID of the task instance for InstanceStateChanged
+    std::string instance_id;
+    /// @brief new state for InstanceStateChanged
+    TaskState state;
+};
+
+/// @brief Criteria for TaskTracker::find_tasks.
+struct TaskFilter
+{
+    /// @brief if set, only tasks with this repeat type match
+    std::optional<RepeatType> repeat_type;
+    /// @brief only tasks whose name starts with this match
+    std::string name_prefix;
+};
+
 /// @brief Class for keeping track of tasks.
 class TaskTracker
 {
@@ -38,33 +88,59 @@ class TaskTracker
     ~TaskTracker();
 
     /// @brief get tasks scheduled for date. This object must not leave scope
-    /// while the results are used.
+    /// while the results are used. The result is cached per date until the
+    /// task definitions change. Instances not loaded yet are read from or
+    /// created in the database, which takes database_lock(), so unless
+    /// is_day_loaded is true the caller mustn't hold only lock().
     /// @param date the date when the tasks are scheduled
     /// @return list of TaskInstance objects sorted by the start time.
     std::vector<TaskInstance*> get_task_instances(
       std::chrono::year_month_day date);
     std::vector<TaskInstance*> get_task_instances(tm date);
 
+    /// @brief Check if get_task_instances can answer for a date from memory,
+    /// without the database.
+    /// @param date the date to check
+    /// @return true if all task instances of the date are loaded
+    bool is_day_loaded(tm date);
+
+    /// @brief get a page of the task instances stored in the database for a
+    /// time range, ordered by the scheduled start. Only instances that have
+    /// been created, e.g. by viewing the day or by catch_up, are listed.
+    /// @param from only instances scheduled at or after this are returned
+    /// @param to only instances scheduled before this are returned
+    /// @param state if set, only instances in this state are returned
+    /// @param after last instance of the previous page, or nullptr
+    /// @param limit maximum number of instances to return
+    /// @return copies of the TaskInstanceData
+    std::vector<std::unique_ptr<TaskInstanceData>> get_task_instance_page(
+      time_t from,
+      time_t to,
+      std::optional<TaskState> state,
+      const TaskInstanceData* after,
+      size_t limit);
+
     /// @brief Add a new task
     /// @param name name of the task
     /// @param repeat_type RepeatType enum
     /// @param repeat_info repeat info, handled based on repeat_type
     /// @param start_time First date of the task and the time when the task
     /// should be scheduled.
-    void add_task(const std::string& name,
-                  RepeatType repeat_type,
-                  int repeat_info,
-                  tm start_time);
-    void add_task(const std::string& name,
-                  RepeatType repeat_type,
-                  int repeat_info,
-                  time_t start_time);
-    void add_task(const std::string& name,
+    /// @return unique ID of the new task
+    int add_task(const std::string& name,
+                 RepeatType repeat_type,
+                 int repeat_info,
+                 tm start_time);
+    int add_task(const std::string& name,
+                 RepeatType repeat_type,
+                 int repeat_info,
+                 time_t start_time);
+    int add_task(const std::string& name,
                   RepeatType repeat_type,
                   int repeat_info,
-                  std::chrono::year_month_day start_date,
-                  std::chrono::hours hour,
-                  std::chrono::minutes mins);
+                 std::chrono::year_month_day start_date,
+                 std::chrono::hours hour,
+                 std::chrono::minutes mins);
 
     /// @brief Delete a task.
     /// @param id unique ID of the task to delete.
@@ -78,18 +154,155 @@ class TaskTracker
     /// in scope and clear isn't called.
     std::vector<Task*> get_tasks();
 
+    /// @brief List a page of the tasks matching a filter, ordered by ID.
+    /// @param filter criteria the tasks must match
+    /// @param after_id only tasks with an ID greater than this are listed
+    /// @param limit maximum number of tasks to return
+    /// @return vector of Task*. Pointers are valid as long as this item is
+    /// kept in scope and clear isn't called.
+    std::vector<Task*> find_tasks(const TaskFilter& filter,
+                                  int after_id,
+                                  size_t limit);
+
     Task* get_task(int id);
 
+    /// @brief Write a task into the database and into the tracker's copy of
+    /// the task, if task isn't that copy itself.
+    /// @param task new data of the task, found by its ID
     void modify_task(const TaskData* task);
 
+    /// @brief Run task modifications (add_task, delete_task, modify_task) in
+    /// a single database transaction. If operations throws, the transaction
+    /// is rolled back, the tasks are reloaded from the database and the
+    /// exception is rethrown.
+    /// @param operations function doing the modifications
+    void transaction(const std::function<void()>& operations);
+
+    /// @brief Create the task instances of the days since the last call, so
+    /// history and overdue tasks are complete even for days nobody viewed.
+    /// All instances are written in a single transaction. On the first call
+    /// only today is processed.
+    /// @param horizon_days at most this many days before today are processed
+    /// @param today the last day to process
+    /// @return number of task occurrences on the processed days
+    size_t catch_up(int horizon_days, std::chrono::year_month_day today);
+    size_t catch_up(int horizon_days);
+
+    /// @brief get the number of days in the task instance cache
+    size_t cached_days() const;
+
+    /// @brief get the generation of the task definitions. It's increased
+    /// every time tasks are added, deleted, modified or reloaded.
+    /// @return current generation
+    uint64_t generation() const;
+
+    /// @brief get the change records after a sequence number. Only the last
+    /// CHANGE_LOG_CAPACITY records are kept, so a reader falling behind
+    /// loses records instead of them piling up.
+    /// @param after sequence of the last record already seen, 0 for none
+    /// @return records ordered by sequence, or std::nullopt if records after
+    /// after were already dropped and the reader must reload everything.
+    std::optional<std::vector<ChangeRecord>> get_changes(uint64_t after);
+
+    /// @brief get the sequence of the newest change record
+    /// @return the sequence, 0 if nothing has been recorded
+    uint64_t last_change_sequence() const;
+
+    /// @brief Lock the in-memory state of the tracker for the calling thread.
+    /// When the tracker is shared between threads, hold this lock while
+    /// calling methods that only read memory, e.g. get_tasks, upcoming or
+    /// get_changes, and while using the pointers they returned. Methods that
+    /// write to the database lock themselves and take this lock only while
+    /// updating memory, so readers don't wait for SQLite. The lock is
+    /// recursive.
+    /// @return lock that is released when it goes out of scope
+    [[nodiscard]] std::unique_lock<std::recursive_mutex> lock();
+
+    /// @brief Lock the database of the tracker for the calling thread.
+    /// Methods using the database take it themselves; hold it across calls
+    /// that must not be interleaved with other writers, e.g. get_task and
+    /// modify_task, and while changing the state of a TaskInstance. When
+    /// both locks are needed this one must be taken first. Memory is only
+    /// modified holding both, so either is enough for reading it. The lock
+    /// is recursive.
+    /// @return lock that is released when it goes out of scope
+    [[nodiscard]] std::unique_lock<std::recursive_mutex> database_lock();
+
+    /// @brief Find when a task next occurs.
+    /// @param task_id unique ID of the task
+    /// @param after only occurrences scheduled after this time are considered
+    /// @return scheduled start of the next occurrence, or std::nullopt if the
+    /// task doesn't exist or never occurs again.
+    std::optional<time_t> next_occurrence(int task_id, time_t after);
+
+    /// @brief List the next occurrences of all tasks.
+    /// @param count maximum number of occurrences to return
+    /// @param after only occurrences scheduled after this time are listed
+    /// @return occurrences sorted by the start time. Pointers are valid as
+    /// long as this item is kept in scope and clear isn't called.
+    std::vector<Occurrence> upcoming(size_t count, time_t after);
+
+    /// @brief Check if the database has been modified by another connection,
+    /// e.g. another process, since the last sync. Only reads PRAGMA
+    /// data_version so this is cheap enough to poll.
+    /// @return true if sync should be called
+    bool has_external_changes();
+
+    /// @brief Reload tasks and loaded task instances that were changed in the
+    /// database by someone else. Only rows changed since the last sync are
+    /// read. Pointers to deleted tasks become invalid.
+    /// @return true if the in-memory data changed
+    bool sync();
+
+    /// @brief Write the tasks into a binary snapshot next to the database.
+    /// The next TaskTracker created for the same database reads the tasks
+    /// from the snapshot instead of the database if nothing has changed
+    /// in between. Call this on clean shutdown.
+    /// @return true if the snapshot was written
+    bool save_snapshot();
+
   private:
     const std::unique_ptr<TaskInstanceDatabase> m_task_instance_db;
     const std::unique_ptr<TaskDatabase> m_task_db;
+    const std::unique_ptr<SettingsDatabase> m_settings_db;
+    const std::filesystem::path m_snapshot_path;
 
     std::vector<std::unique_ptr<TaskData>> m_task_data;
     std::map<std::string, std::unique_ptr<TaskInstance>> m_task_instances;
+    /// @brief tasks sorted by ID
     std::vector<std::unique_ptr<Task>> m_tasks;
 
+    /// @brief Sorted task instances of a day, valid while generation matches
+    /// m_generation.
+    struct DayInstances
+    {
+        uint64_t generation;
+        std::vector<TaskInstance*> instances;
+    };
+
+    /// @brief guards the in-memory state, see lock()
+    std::recursive_mutex m_mutex;
+    /// @brief serializes the database access, see database_lock()
+    std::recursive_mutex m_database_mutex;
+
+    uint64_t m_generation{ 0 };
+    /// @brief cached task instances keyed by date as YYYYMMDD
+    std::unordered_map<int, DayInstances> m_day_instances;
+
+    /// @brief ring buffer of the last CHANGE_LOG_CAPACITY change records
+    std::vector<ChangeRecord> m_changes;
+    /// @brief sequence of the newest record in m_changes
+    uint64_t m_change_sequence{ 0 };
+    /// @brief sequence of the oldest record in m_changes
+    uint64_t m_first_change{ 1 };
+
+    /// @brief data_version of the database at the last sync
+    int m_data_version{ 0 };
+    /// @brief newest change number of the task table read by sync
+    long long m_task_watermark{ 0 };
+    /// @brief newest change number of the task instance table read by sync
+    long long m_task_instance_watermark{ 0 };
+
     /// @brief Create a unique identifier for a TaskInstance based on the Task
     /// and it's date
     /// @param day the scheduled date
@@ -98,11 +311,49 @@ class TaskTracker
                                     Task* task);
     std::string m_create_identifier(tm day, Task* task);
 
-    void m_create_task_instance(const std::unique_ptr<Task>& task,
-                                tm date,
-                                const std::string& instance_id);
+    /// @brief normalize date to noon of the day and get its cache key
+    /// @return the date as YYYYMMDD
+    int m_day_key(tm& date);
+
+    /// @brief get the tasks occurring on a normalized date with the
+    /// identifiers of their instances
+    std::vector<std::pair<Task*, std::string>> m_occurring_tasks(tm date);
+
+    /// @brief sort and cache the loaded instances of the occurring tasks
+    std::vector<TaskInstance*> m_cache_day(
+      int key,
+      const std::vector<std::pair<Task*, std::string>>& occurring);
+
+    /// @brief read a task instance from the database, creating it first if
+    /// needed. Only touches the database.
+    std::unique_ptr<TaskInstanceData> m_load_task_instance(
+      Task* task,
+      tm date,
+      const std::string& instance_id);
+
+    /// @brief add a task instance read by m_load_task_instance to memory
+    void m_add_task_instance(std::unique_ptr<TaskInstanceData> data);
 
+    /// @brief get the date and time a task starts on a day
+    time_t m_scheduled_start(Task* task, tm date);
+
+    /// @brief read the tasks from the snapshot or the database and replace
+    /// the loaded ones. The database is read before taking lock().
     void m_load_tasks();
+
+    /// @brief get the first task in m_tasks whose ID isn't less than id
+    std::vector<std::unique_ptr<Task>>::iterator m_find_task_position(int id);
+
+    std::optional<time_t> m_next_occurrence(Task* task, time_t after);
+
+    void m_record_change(ChangeType type,
+                         int task_id,
+                         const TaskInstance* instance = nullptr);
+    /// @brief drop the records newer than sequence
+    void m_drop_changes(uint64_t sequence);
+
+    bool m_sync_tasks();
+    bool m_sync_task_instances();
 };
 } // namespace tasktracker
 
@@ -0,0 +1,227 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace tasktracker {
+
+namespace {
+
+const std::vector<double> DEFAULT_BOUNDS = { 0.0001, 0.0005, 0.001, 0.0025,
+                                             0.005,  0.01,   0.025, 0.05,
+                                             0.1,    0.25,   0.5,   1,
+                                             2.5 };
+
+size_t
+shard_index()
+{
+    static std::atomic<size_t> next{ 0 };
+    thread_local const size_t index = next++ % METRIC_SHARDS;
+    return index;
+}
+
+void
+append_number(std::string& out, double value)
+{
+    char buffer[32];
+    const auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, res.ptr);
+}
+
+void
+append_number(std::string& out, uint64_t value)
+{
+    char buffer[24];
+    const auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, res.ptr);
+}
+
+void
+append_labels(std::string& out,
+              const std::string& labels,
+              const std::string& extra = "")
+{
+    if (labels.empty() && extra.empty()) {
+        return;
+    }
+    out += '{';
+    out += labels;
+    if (!labels.empty() && !extra.empty()) {
+        out += ',';
+    }
+    out += extra;
+    out += '}';
+}
+
+} // namespace
+
+void
+MetricCounter::add(uint64_t value)
+{
+    m_shards[shard_index()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t
+MetricCounter::value() const
+{
+    uint64_t sum = 0;
+    for (const auto& shard : m_shards) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+MetricHistogram::MetricHistogram(std::vector<double> bounds)
+  : m_bounds(std::move(bounds))
+{
+    for (auto& shard : m_shards) {
+        shard.buckets =
+          std::make_unique<std::atomic<uint64_t>[]>(m_bounds.size() + 1);
+    }
+}
+
+void
+MetricHistogram::observe(double value)
+{
+    const size_t bucket =
+      std::lower_bound(m_bounds.begin(), m_bounds.end(), value) -
+      m_bounds.begin();
+    auto& shard = m_shards[shard_index()];
+
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+MetricHistogram::Snapshot
+MetricHistogram::snapshot() const
+{
+    Snapshot result{ m_bounds, std::vector<uint64_t>(m_bounds.size() + 1), 0 };
+
+    for (const auto& shard : m_shards) {
+        for (size_t i = 0; i <= m_bounds.size(); ++i) {
+            result.counts[i] +=
+              shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        result.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    for (size_t i = 1; i < result.counts.size(); ++i) {
+        result.counts[i] += result.counts[i - 1];
+    }
+    return result;
+}
+
+ScopedMetricTimer::ScopedMetricTimer(MetricHistogram& histogram)
+  : m_histogram(histogram)
+  , m_start(std::chrono::steady_clock::now())
+{
+}
+
+ScopedMetricTimer::~ScopedMetricTimer()
+{
+    const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - m_start;
+    m_histogram.observe(elapsed.count());
+}
+
+Metrics&
+Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+MetricCounter&
+Metrics::counter(const std::string& name,
+                 const std::string& help,
+                 const std::string& labels)
+{
+    std::lock_guard lock(m_mutex);
+    auto [it, created] = m_families.try_emplace(name);
+    auto& family = it->second;
+    // The first registration describes the family, later lookups may
+    // pass any help.
+    if (created) {
+        family.help = help;
+    }
+
+    auto& counter = family.counters[labels];
+    if (!counter) {
+        counter = std::make_unique<MetricCounter>();
+    }
+    return *counter;
+}
+
+MetricHistogram&
+Metrics::histogram(const std::string& name,
+                   const std::string& help,
+                   const std::string& labels,
+                   std::vector<double> bounds)
+{
+    std::lock_guard lock(m_mutex);
+    auto [it, created] = m_families.try_emplace(name);
+    auto& family = it->second;
+    // The first registration describes the family, later lookups may
+    // pass any help.
+    if (created) {
+        family.help = help;
+    }
+
+    auto& histogram = family.histograms[labels];
+    if (!histogram) {
+        histogram = std::make_unique<MetricHistogram>(
+          bounds.empty() ? DEFAULT_BOUNDS : std::move(bounds));
+    }
+    return *histogram;
+}
+
+void
+Metrics::write(std::string& out) const
+{
+    std::lock_guard lock(m_mutex);
+
+    for (const auto& [name, family] : m_families) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name;
+        out += family.histograms.empty() ? " counter\n" : " histogram\n";
+
+        for (const auto& [labels, counter] : family.counters) {
+            out += name;
+            append_labels(out, labels);
+            out += ' ';
+            append_number(out, counter->value());
+            out += '\n';
+        }
+
+        for (const auto& [labels, histogram] : family.histograms) {
+            const auto snapshot = histogram->snapshot();
+
+            for (size_t i = 0; i < snapshot.counts.size(); ++i) {
+                std::string le = "le=\"";
+                if (i < snapshot.bounds.size()) {
+                    append_number(le, snapshot.bounds[i]);
+                } else {
+                    le += "+Inf";
+                }
+                le += '"';
+
+                out += name + "_bucket";
+                append_labels(out, labels, le);
+                out += ' ';
+                append_number(out, snapshot.counts[i]);
+                out += '\n';
+            }
+            out += name + "_sum";
+            append_labels(out, labels);
+            out += ' ';
+            append_number(out, snapshot.sum);
+            out += '\n';
+            out += name + "_count";
+            append_labels(out, labels);
+            out += ' ';
+            append_number(out, snapshot.counts.back());
+            out += '\n';
+        }
+    }
+}
+
+} // namespace tasktracker
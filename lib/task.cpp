@@ -6,17 +6,33 @@ static tm
 s_get_nth_weekday_of_month(int day, int week, tm schedule_tm)
 {
     schedule_tm.tm_mday = 1;
-    schedule_tm.tm_hour = 0;
+    // Step from noon so DST changes during the month don't move the date.
+    // The DST flag of the given day may not apply on the 1st.
+    schedule_tm.tm_hour = 12;
+    schedule_tm.tm_isdst = -1;
 
     time_t one_day = 24 * 60 * 60;
 
     time_t t = mktime(&schedule_tm);
 
-    while (localtime(&t)->tm_wday != day) {
+    tm result{};
+    while (localtime_r(&t, &result)->tm_wday != day) {
         t += one_day;
     } // t now at first occurance of day.
     t += (week - 1) * 7 * one_day;
-    return *localtime(&t);
+    localtime_r(&t, &result);
+    return result;
+}
+
+static std::chrono::year_month_day
+s_local_date(time_t time)
+{
+    tm time_tm{};
+    localtime_r(&time, &time_tm);
+    return std::chrono::year_month_day(
+      std::chrono::year(time_tm.tm_year + 1900),
+      std::chrono::month(time_tm.tm_mon + 1),
+      std::chrono::day(time_tm.tm_mday));
 }
 
 namespace tasktracker {
@@ -51,27 +67,23 @@ TaskInstance::get_parent_id() const
 void
 TaskInstance::start_task()
 {
-    m_data->state = TaskState::Started;
-    m_db->update_task(m_data.get());
+    m_set_state(TaskState::Started);
 }
 void
 TaskInstance::skip_task()
 {
-    m_data->state = TaskState::Skipped;
-    m_db->update_task(m_data.get());
+    m_set_state(TaskState::Skipped);
 }
 void
 TaskInstance::finish_task()
 {
-    m_data->state = TaskState::Finished;
-    m_db->update_task(m_data.get());
+    m_set_state(TaskState::Finished);
 }
 
 void
 TaskInstance::set_undone()
 {
-    m_data->state = TaskState::NotStarted;
-    m_db->update_task(m_data.get());
+    m_set_state(TaskState::NotStarted);
 }
 
 time_t
@@ -85,7 +97,8 @@ TaskInstance::get_scheduled_time() const
 {
     tm start_time{};
     const time_t start_datetime = get_scheduled_datetime();
-    tm start_datetime_tm = *localtime(&start_datetime);
+    tm start_datetime_tm{};
+    localtime_r(&start_datetime, &start_datetime_tm);
 
     start_time.tm_year = start_datetime_tm.tm_year;
     start_time.tm_hour = start_datetime_tm.tm_hour;
@@ -119,6 +132,12 @@ TaskInstance::get_data() const
     return m_data.get();
 }
 
+void
+TaskInstance::reload(const TaskInstanceData& data)
+{
+    *m_data = data;
+}
+
 bool
 TaskInstance::is_finished() const
 {
@@ -137,6 +156,23 @@ TaskInstance::is_started() const
     return m_data->state == TaskState::Started;
 }
 
+void
+TaskInstance::set_state_changed_cb(
+  std::function<void(const TaskInstance&)> cb)
+{
+    m_state_changed_cb = std::move(cb);
+}
+
+void
+TaskInstance::m_set_state(TaskState state)
+{
+    m_data->state = state;
+    m_db->update_task(m_data.get());
+    if (m_state_changed_cb) {
+        m_state_changed_cb(*this);
+    }
+}
+
 Task::Task(TaskData* data, TaskDatabase* db)
   : m_data(data)
   , m_db(db)
@@ -148,11 +184,12 @@ Task::~Task() {}
 ScheduledTime
 Task::get_scheduled_start_time()
 {
-    tm* time_struct = localtime(&m_data->scheduled_start);
+    tm time_struct{};
+    localtime_r(&m_data->scheduled_start, &time_struct);
 
     ScheduledTime time;
-    time.hours = std::chrono::hours(time_struct->tm_hour);
-    time.minutes = std::chrono::minutes(time_struct->tm_min);
+    time.hours = std::chrono::hours(time_struct.tm_hour);
+    time.minutes = std::chrono::minutes(time_struct.tm_min);
     return time;
 }
 
@@ -196,7 +233,8 @@ Task::occurs(std::chrono::year_month_day day)
     time.tm_mday = static_cast<unsigned int>(day.day());
 
     time_t t = mktime(&time);
-    tm tm = *localtime(&t);
+    tm tm{};
+    localtime_r(&t, &tm);
 
     return occurs(tm);
 }
@@ -204,7 +242,8 @@ Task::occurs(std::chrono::year_month_day day)
 bool
 Task::occurs(tm day)
 {
-    tm schedule_tm = *localtime(&m_data->scheduled_start);
+    tm schedule_tm{};
+    localtime_r(&m_data->scheduled_start, &schedule_tm);
     int repeat_info = m_data->repeat_info;
 
     switch (m_data->repeat_type) {
@@ -240,7 +279,8 @@ Task::occurs(tm day)
         }
         case RepeatType::WithInterval:
             time_t start_day = m_data->scheduled_start;
-            tm start_day_tm = *localtime(&start_day);
+            tm start_day_tm{};
+            localtime_r(&start_day, &start_day_tm);
             start_day_tm.tm_hour = 0;
             start_day_tm.tm_min = 0;
             start_day_tm.tm_sec = 0;
@@ -261,4 +301,93 @@ Task::occurs(tm day)
     return false;
 }
 
+std::optional<std::chrono::year_month_day>
+Task::next_occurrence(std::chrono::year_month_day from) const
+{
+    using namespace std::chrono;
+
+    const int repeat_info = m_data->repeat_info;
+    const sys_days from_days{ from };
+
+    switch (m_data->repeat_type) {
+        case RepeatType::NoRepeat: {
+            const auto start = s_local_date(m_data->scheduled_start);
+            if (sys_days{ start } < from_days) {
+                return std::nullopt;
+            }
+            return start;
+        }
+
+        case RepeatType::Monthly: {
+            if (repeat_info < 1 || repeat_info > 31) {
+                return std::nullopt;
+            }
+            year_month month = from.year() / from.month();
+            if (from.day() > day(repeat_info)) {
+                month += months(1);
+            }
+            // Every day of month up to 31 exists at least once in 12 months.
+            for (int i = 0; i < 12; ++i, month += months(1)) {
+                const year_month_day candidate = month / day(repeat_info);
+                if (candidate.ok()) {
+                    return candidate;
+                }
+            }
+            return std::nullopt;
+        }
+
+        case RepeatType::MonthlyDay: {
+            const weekday week_day(static_cast<unsigned>(repeat_info % 10 % 7));
+            const unsigned week = (repeat_info / 10) % 10;
+            if (week < 1 || week > 5) {
+                return std::nullopt;
+            }
+            year_month month = from.year() / from.month();
+            // A fifth weekday exists in at least one of any three months.
+            for (int i = 0; i < 12; ++i, month += months(1)) {
+                const year_month_weekday candidate =
+                  month / week_day[week];
+                if (candidate.ok() && sys_days{ candidate } >= from_days) {
+                    return year_month_day{ candidate };
+                }
+            }
+            return std::nullopt;
+        }
+
+        case RepeatType::SpecifiedDays: {
+            const weekday from_weekday{ from_days };
+            std::optional<days> offset;
+
+            for (int info = repeat_info; info > 0; info /= 10) {
+                const int info_day = info % 10;
+                if (info_day > 7) {
+                    continue;
+                }
+                const days day_offset = weekday(info_day % 7) - from_weekday;
+                if (!offset || day_offset < *offset) {
+                    offset = day_offset;
+                }
+            }
+            if (!offset) {
+                return std::nullopt;
+            }
+            return year_month_day{ from_days + *offset };
+        }
+
+        case RepeatType::WithInterval: {
+            if (repeat_info <= 0) {
+                return std::nullopt;
+            }
+            const sys_days start{ s_local_date(m_data->scheduled_start) };
+            if (from_days <= start) {
+                return year_month_day{ start };
+            }
+            const auto elapsed = (from_days - start).count();
+            const auto intervals = (elapsed + repeat_info - 1) / repeat_info;
+            return year_month_day{ start + days(intervals * repeat_info) };
+        }
+    }
+    return std::nullopt;
+}
+
 } // namespace tasktracker
@@ -0,0 +1,204 @@
+#include "task_snapshot.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tasktracker {
+
+namespace {
+
+const uint32_t SNAPSHOT_MAGIC = 0x4e535454; // "TTSN"
+
+struct SnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t change;
+    uint64_t task_count;
+    uint64_t strings_size;
+    uint64_t checksum;
+};
+
+/// @brief Fixed size part of a task. Strings are stored after the records
+/// and referenced by offset and length.
+struct SnapshotRecord
+{
+    uint64_t id;
+    int64_t scheduled_start;
+    int32_t repeat_type;
+    int32_t repeat_info;
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t state_offset;
+    uint32_t state_size;
+    uint32_t comment_offset;
+    uint32_t comment_size;
+};
+
+uint64_t
+fnv1a(const char* data, size_t size, uint64_t hash = 0xcbf29ce484222325)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+void
+append_string(std::string& strings,
+              const std::string& str,
+              uint32_t& offset,
+              uint32_t& size)
+{
+    offset = strings.size();
+    size = str.size();
+    strings += str;
+}
+
+} // namespace
+
+bool
+write_task_snapshot(const std::filesystem::path& path,
+                    long long change,
+                    const std::vector<const TaskData*>& tasks)
+{
+    std::vector<SnapshotRecord> records;
+    std::string strings;
+    records.reserve(tasks.size());
+
+    for (const auto* task : tasks) {
+        SnapshotRecord record{};
+        record.id = task->id;
+        record.scheduled_start = task->scheduled_start;
+        record.repeat_type = static_cast<int32_t>(task->repeat_type);
+        record.repeat_info = task->repeat_info;
+        append_string(
+          strings, task->name, record.name_offset, record.name_size);
+        append_string(
+          strings, task->state, record.state_offset, record.state_size);
+        append_string(
+          strings, task->comment, record.comment_offset, record.comment_size);
+        records.push_back(record);
+    }
+
+    const auto* records_data = reinterpret_cast<const char*>(records.data());
+    const size_t records_size = records.size() * sizeof(SnapshotRecord);
+
+    SnapshotHeader header{};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = TASK_SNAPSHOT_VERSION;
+    header.change = change;
+    header.task_count = records.size();
+    header.strings_size = strings.size();
+    header.checksum = fnv1a(strings.data(),
+                            strings.size(),
+                            fnv1a(records_data, records_size));
+
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(records_data, records_size);
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmp_path, path, err);
+    return !err;
+}
+
+std::optional<std::vector<std::unique_ptr<TaskData>>>
+read_task_snapshot(const std::filesystem::path& path, long long change)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st
+    {};
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    const size_t file_size = st.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    const char* data = static_cast<const char*>(mapping);
+    std::optional<std::vector<std::unique_ptr<TaskData>>> result;
+
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    const size_t records_size = header.task_count * sizeof(SnapshotRecord);
+    const bool valid_header =
+      header.magic == SNAPSHOT_MAGIC &&
+      header.version == TASK_SNAPSHOT_VERSION && header.change == change &&
+      header.task_count <= file_size / sizeof(SnapshotRecord) &&
+      file_size == sizeof(header) + records_size + header.strings_size;
+
+    if (valid_header) {
+        const char* records_data = data + sizeof(header);
+        const char* strings = records_data + records_size;
+
+        if (fnv1a(strings,
+                  header.strings_size,
+                  fnv1a(records_data, records_size)) == header.checksum) {
+            std::vector<std::unique_ptr<TaskData>> tasks;
+            tasks.reserve(header.task_count);
+            const auto fits = [&header](uint64_t offset, uint64_t size) {
+                return offset + size <= header.strings_size;
+            };
+
+            for (uint64_t i = 0; i < header.task_count; ++i) {
+                SnapshotRecord record;
+                std::memcpy(&record,
+                            records_data + i * sizeof(SnapshotRecord),
+                            sizeof(record));
+
+                if (!fits(record.name_offset, record.name_size) ||
+                    !fits(record.state_offset, record.state_size) ||
+                    !fits(record.comment_offset, record.comment_size)) {
+                    break;
+                }
+
+                auto task = std::make_unique<TaskData>();
+                task->id = record.id;
+                task->scheduled_start = record.scheduled_start;
+                task->repeat_type = static_cast<RepeatType>(record.repeat_type);
+                task->repeat_info = record.repeat_info;
+                task->name.assign(strings + record.name_offset,
+                                  record.name_size);
+                task->state.assign(strings + record.state_offset,
+                                   record.state_size);
+                task->comment.assign(strings + record.comment_offset,
+                                     record.comment_size);
+                tasks.push_back(std::move(task));
+            }
+            if (tasks.size() == header.task_count) {
+                result = std::move(tasks);
+            }
+        }
+    }
+
+    munmap(mapping, file_size);
+    return result;
+}
+
+} // namespace tasktracker
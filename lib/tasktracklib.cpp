@@ -1,7 +1,12 @@
 #include "tasktracklib.h"
+#include "metrics.h"
+#include "task_snapshot.h"
 
 #include <algorithm>
 #include <iostream>
+#include <queue>
+
+#define LAST_PROCESSED_DAY "LAST_PROCESSED_DAY"
 
 namespace tasktracker {
 
@@ -16,16 +21,22 @@ format_date(tm* date, const std::string& str = "")
 std::string
 format_date(time_t* date, const std::string& str = "")
 {
-    tm* time_tm = localtime(date);
-    return format_date(time_tm, str);
+    tm time_tm{};
+    localtime_r(date, &time_tm);
+    return format_date(&time_tm, str);
 }
 
 TaskTracker::TaskTracker(std::filesystem::path path)
   : m_task_instance_db(std::make_unique<TaskInstanceDatabase>(path))
   , m_task_db(std::make_unique<TaskDatabase>(path))
+  , m_settings_db(std::make_unique<SettingsDatabase>(path))
+  , m_snapshot_path(path.string() + ".snapshot")
 {
     m_task_instance_db->init();
     m_task_db->init();
+    m_settings_db->init();
+    m_data_version = m_task_db->data_version();
+    m_task_instance_watermark = m_task_instance_db->last_change();
     m_load_tasks();
 }
 
@@ -45,32 +56,85 @@ TaskTracker::get_task_instances(std::chrono::year_month_day date)
 std::vector<TaskInstance*>
 TaskTracker::get_task_instances(tm date)
 {
-    std::vector<TaskInstance*> task_instances;
+    const int key = m_day_key(date);
+    static auto& hits = Metrics::instance().counter(
+      "tasktracker_instance_cache_requests_total",
+      "Days requested with get_task_instances by cache result.",
+      "result=\"hit\"");
+    static auto& misses = Metrics::instance().counter(
+      "tasktracker_instance_cache_requests_total",
+      "Days requested with get_task_instances by cache result.",
+      "result=\"miss\"");
+
+    {
+        const auto state = lock();
+        const auto cached = m_day_instances.find(key);
+        if (cached != m_day_instances.end() &&
+            cached->second.generation == m_generation) {
+            hits.add();
+            return cached->second.instances;
+        }
+        misses.add();
+
+        const auto occurring = m_occurring_tasks(date);
+        if (std::all_of(
+              occurring.begin(), occurring.end(), [this](const auto& item) {
+                  return m_task_instances.contains(item.second);
+              })) {
+            return m_cache_day(key, occurring);
+        }
+    }
 
-    for (auto& task : m_tasks) {
-        if (task->occurs(date)) {
-            auto instance_id = m_create_identifier(date, task.get());
-            if (!m_task_instances.contains(instance_id)) {
-                m_create_task_instance(task, date, instance_id);
-            }
-            task_instances.push_back(m_task_instances.at(instance_id).get());
+    // The tasks may have changed before the database lock was taken, so
+    // they are listed again. The instances are read without holding the
+    // state lock.
+    const auto database = database_lock();
+    const auto occurring = m_occurring_tasks(date);
+    std::vector<std::unique_ptr<TaskInstanceData>> loaded;
+    for (const auto& [task, instance_id] : occurring) {
+        if (!m_task_instances.contains(instance_id)) {
+            loaded.push_back(m_load_task_instance(task, date, instance_id));
         }
     }
 
-    std::sort(task_instances.begin(),
-              task_instances.end(),
-              [](const auto& a, const auto& b) {
-                  if (a->get_scheduled_time() == b->get_scheduled_time())
-                    [[unlikely]] {
-                      return a->get_name() < b->get_name();
-                  }
-                  return a->get_scheduled_time() < b->get_scheduled_time();
-              });
+    const auto state = lock();
+    for (auto& data : loaded) {
+        m_add_task_instance(std::move(data));
+    }
+    return m_cache_day(key, occurring);
+}
 
-    return task_instances;
+bool
+TaskTracker::is_day_loaded(tm date)
+{
+    const int key = m_day_key(date);
+    const auto state = lock();
+    const auto cached = m_day_instances.find(key);
+    if (cached != m_day_instances.end() &&
+        cached->second.generation == m_generation) {
+        return true;
+    }
+
+    const auto occurring = m_occurring_tasks(date);
+    return std::all_of(
+      occurring.begin(), occurring.end(), [this](const auto& item) {
+          return m_task_instances.contains(item.second);
+      });
 }
 
-void
+std::vector<std::unique_ptr<TaskInstanceData>>
+TaskTracker::get_task_instance_page(time_t from,
+                                    time_t to,
+                                    std::optional<TaskState> state,
+                                    const TaskInstanceData* after,
+                                    size_t limit)
+{
+    const auto database = database_lock();
+    return m_task_instance_db->get_tasks_in_range(
+      from, to, state, after, limit);
+}
+
+int
 TaskTracker::add_task(const std::string& name,
                       RepeatType repeat_type,
                       int repeat_info,
@@ -86,12 +150,13 @@ TaskTracker::add_task(const std::string& name,
 
     start_time.tm_hour = hour.count();
     start_time.tm_min = mins.count();
-    add_task(name, repeat_type, repeat_info, start_time);
+    return add_task(name, repeat_type, repeat_info, start_time);
 }
 
 void
 TaskTracker::delete_task(int id)
 {
+    const auto database = database_lock();
     auto task = m_task_db->get_task(id);
     if (task == nullptr) {
         return;
@@ -99,21 +164,22 @@ TaskTracker::delete_task(int id)
 
     m_task_db->delete_task(task.get());
 
-    const auto it =
-      std::find_if(m_tasks.begin(), m_tasks.end(), [id](const auto& n_task) {
-          return n_task->get_id() == id;
-      });
-    if (it != m_tasks.end()) {
+    const auto state = lock();
+    const auto it = m_find_task_position(id);
+    if (it != m_tasks.end() && (*it)->get_id() == id) {
         m_tasks.erase(it);
     }
+    ++m_generation;
+    m_record_change(ChangeType::TaskDeleted, id);
 }
 
-void
+int
 TaskTracker::add_task(const std::string& name,
                       RepeatType repeat_type,
                       int repeat_info,
                       tm start_time)
 {
+    const auto database = database_lock();
     auto id = m_task_db->create_task(name);
     auto task = m_task_db->get_task(id);
     task->repeat_type = repeat_type;
@@ -121,31 +187,44 @@ TaskTracker::add_task(const std::string& name,
     task->scheduled_start = mktime(&start_time);
     m_task_db->update_task(task.get());
 
-    std::cout << "Update task to start time:" << ctime(&task->scheduled_start);
+    std::cout << format_date(&task->scheduled_start,
+                             "Update task to start time: ")
+              << std::endl;
 
+    const auto state = lock();
     m_task_data.push_back(std::move(task));
 
     auto task_ =
       std::make_unique<Task>(m_task_data.back().get(), m_task_db.get());
-    m_tasks.push_back(std::move(task_));
+    m_tasks.insert(m_find_task_position(id), std::move(task_));
+    ++m_generation;
+    m_record_change(ChangeType::TaskCreated, id);
+    return id;
 }
 
-void
+int
 TaskTracker::add_task(const std::string& name,
                       RepeatType repeat_type,
                       int repeat_info,
                       time_t start_time)
 {
-    tm* start_time_tm = localtime(&start_time);
-    add_task(name, repeat_type, repeat_info, *start_time_tm);
+    tm start_time_tm{};
+    localtime_r(&start_time, &start_time_tm);
+    return add_task(name, repeat_type, repeat_info, start_time_tm);
 }
 
 void
 TaskTracker::clear()
 {
+    const auto database = database_lock();
     m_task_db->clear();
     m_task_instance_db->clear();
+    m_settings_db->clear();
+    m_task_instance_watermark = m_task_instance_db->last_change();
     m_load_tasks();
+
+    const auto state = lock();
+    m_record_change(ChangeType::Reset, 0);
 }
 
 std::vector<Task*>
@@ -160,14 +239,35 @@ TaskTracker::get_tasks()
     return tasks;
 }
 
+std::vector<Task*>
+TaskTracker::find_tasks(const TaskFilter& filter, int after_id, size_t limit)
+{
+    std::vector<Task*> tasks;
+
+    auto it = std::upper_bound(
+      m_tasks.begin(), m_tasks.end(), after_id, [](int id, const auto& task) {
+          return id < task->get_id();
+      });
+
+    for (; it != m_tasks.end() && tasks.size() < limit; ++it) {
+        TaskData* data = (*it)->get_data();
+        if (filter.repeat_type && data->repeat_type != *filter.repeat_type) {
+            continue;
+        }
+        if (!data->name.starts_with(filter.name_prefix)) {
+            continue;
+        }
+        tasks.push_back(it->get());
+    }
+
+    return tasks;
+}
+
 Task*
 TaskTracker::get_task(int id)
 {
-    const auto it =
-      std::find_if(m_tasks.begin(), m_tasks.end(), [id](const auto& task) {
-          return (task->get_id() == id);
-      });
-    if (it == m_tasks.end()) {
+    const auto it = m_find_task_position(id);
+    if (it == m_tasks.end() || (*it)->get_id() != id) {
         return nullptr;
     }
     return it->get();
@@ -176,7 +276,243 @@ TaskTracker::get_task(int id)
 void
 TaskTracker::modify_task(const TaskData* task)
 {
+    const auto database = database_lock();
     m_task_db->update_task(task);
+
+    const auto state = lock();
+    Task* loaded = get_task(task->id);
+    if (loaded != nullptr && loaded->get_data() != task) {
+        *loaded->get_data() = *task;
+    }
+    ++m_generation;
+    m_record_change(ChangeType::TaskUpdated, task->id);
+}
+
+size_t
+TaskTracker::catch_up(int horizon_days, std::chrono::year_month_day today)
+{
+    using namespace std::chrono;
+
+    const auto database = database_lock();
+    const sys_days last_day{ today };
+    const sys_days processed{ days(m_settings_db->get_value(
+      LAST_PROCESSED_DAY, (last_day - days(1)).time_since_epoch().count())) };
+    const sys_days first_day =
+      std::max(processed + days(1), last_day - days(horizon_days));
+
+    if (first_day > last_day) {
+        return 0;
+    }
+
+    std::vector<TaskInstanceData> instances;
+
+    for (sys_days day = first_day; day <= last_day; day += days(1)) {
+        const year_month_day ymd{ day };
+        tm date{};
+        date.tm_year = static_cast<int>(ymd.year()) - 1900;
+        date.tm_mon = static_cast<unsigned int>(ymd.month()) - 1;
+        date.tm_mday = static_cast<unsigned int>(ymd.day());
+        date.tm_hour = 12;
+        date.tm_isdst = -1;
+        mktime(&date);
+
+        for (const auto& task : m_tasks) {
+            if (!task->occurs(date)) {
+                continue;
+            }
+            TaskInstanceData data{};
+            data.id = m_create_identifier(date, task.get());
+            data.parent_id = task->get_id();
+            data.name = task->get_name();
+            data.scheduled_start = m_scheduled_start(task.get(), date);
+            instances.push_back(std::move(data));
+        }
+    }
+
+    m_task_instance_db->create_tasks(instances);
+    m_settings_db->set_value(LAST_PROCESSED_DAY,
+                             last_day.time_since_epoch().count());
+    return instances.size();
+}
+
+size_t
+TaskTracker::catch_up(int horizon_days)
+{
+    time_t now = std::chrono::system_clock::to_time_t(
+      std::chrono::system_clock::now());
+    tm today{};
+    localtime_r(&now, &today);
+
+    return catch_up(horizon_days,
+                    std::chrono::year_month_day(
+                      std::chrono::year(today.tm_year + 1900),
+                      std::chrono::month(today.tm_mon + 1),
+                      std::chrono::day(today.tm_mday)));
+}
+
+void
+TaskTracker::transaction(const std::function<void()>& operations)
+{
+    // Other writers wait for the whole transaction, readers only for the
+    // in-memory updates of the operations.
+    const auto database = database_lock();
+    const uint64_t sequence = m_change_sequence;
+
+    m_task_db->begin_transaction();
+    try {
+        operations();
+        m_task_db->commit();
+    } catch (...) {
+        m_task_db->rollback();
+        m_load_tasks();
+        // Readers that already saw the rolled back records are now ahead of
+        // the sequence, so get_changes tells them to reload.
+        const auto state = lock();
+        m_drop_changes(sequence);
+        throw;
+    }
+}
+
+size_t
+TaskTracker::cached_days() const
+{
+    return m_day_instances.size();
+}
+
+uint64_t
+TaskTracker::generation() const
+{
+    return m_generation;
+}
+
+std::optional<std::vector<ChangeRecord>>
+TaskTracker::get_changes(uint64_t after)
+{
+    if (after > m_change_sequence || after + 1 < m_first_change) {
+        return std::nullopt;
+    }
+
+    std::vector<ChangeRecord> changes;
+    changes.reserve(m_change_sequence - after);
+    for (uint64_t sequence = after + 1; sequence <= m_change_sequence;
+         ++sequence) {
+        changes.push_back(m_changes[(sequence - 1) % CHANGE_LOG_CAPACITY]);
+    }
+    return changes;
+}
+
+uint64_t
+TaskTracker::last_change_sequence() const
+{
+    return m_change_sequence;
+}
+
+std::unique_lock<std::recursive_mutex>
+TaskTracker::lock()
+{
+    return std::unique_lock{ m_mutex };
+}
+
+std::unique_lock<std::recursive_mutex>
+TaskTracker::database_lock()
+{
+    return std::unique_lock{ m_database_mutex };
+}
+
+std::optional<time_t>
+TaskTracker::next_occurrence(int task_id, time_t after)
+{
+    Task* task = get_task(task_id);
+    if (task == nullptr) {
+        return std::nullopt;
+    }
+    return m_next_occurrence(task, after);
+}
+
+std::vector<Occurrence>
+TaskTracker::upcoming(size_t count, time_t after)
+{
+    const auto later = [](const Occurrence& a, const Occurrence& b) {
+        if (a.scheduled_start == b.scheduled_start) [[unlikely]] {
+            return a.task->get_name() > b.task->get_name();
+        }
+        return a.scheduled_start > b.scheduled_start;
+    };
+    std::priority_queue<Occurrence, std::vector<Occurrence>, decltype(later)>
+      queue(later);
+
+    for (const auto& task : m_tasks) {
+        if (auto start = m_next_occurrence(task.get(), after)) {
+            queue.push({ task.get(), *start });
+        }
+    }
+
+    std::vector<Occurrence> occurrences;
+    occurrences.reserve(std::min(count, queue.size()));
+
+    while (occurrences.size() < count && !queue.empty()) {
+        const Occurrence next = queue.top();
+        queue.pop();
+        occurrences.push_back(next);
+
+        if (auto start = m_next_occurrence(next.task, next.scheduled_start)) {
+            queue.push({ next.task, *start });
+        }
+    }
+
+    return occurrences;
+}
+
+bool
+TaskTracker::has_external_changes()
+{
+    const auto database = database_lock();
+    return m_task_db->data_version() != m_data_version;
+}
+
+bool
+TaskTracker::save_snapshot()
+{
+    // Bring in own and external changes so the snapshot matches
+    // m_task_watermark. Nobody can modify the tasks while the database is
+    // locked, so they're written without the state lock.
+    const auto database = database_lock();
+    sync();
+
+    std::vector<const TaskData*> tasks;
+    tasks.reserve(m_tasks.size());
+    for (const auto& task : m_tasks) {
+        tasks.push_back(task->get_data());
+    }
+
+    return write_task_snapshot(m_snapshot_path, m_task_watermark, tasks);
+}
+
+bool
+TaskTracker::sync()
+{
+    const auto database = database_lock();
+    const int version = m_task_db->data_version();
+    if (version == m_data_version) {
+        return false;
+    }
+    m_data_version = version;
+
+    const uint64_t sequence = m_change_sequence;
+    const bool tasks_changed = m_sync_tasks();
+    const bool task_instances_changed = m_sync_task_instances();
+    if (tasks_changed || task_instances_changed) {
+        const auto state = lock();
+        ++m_generation;
+        // The records were made before the generation was increased.
+        for (auto& record : m_changes) {
+            if (record.sequence > sequence) {
+                record.generation = m_generation;
+            }
+        }
+        return true;
+    }
+    return false;
 }
 
 std::string
@@ -201,10 +537,65 @@ TaskTracker::m_create_identifier(tm day, Task* task)
     return str;
 }
 
-void
-TaskTracker::m_create_task_instance(const std::unique_ptr<Task>& task,
-                                    tm date,
-                                    const std::string& instance_id)
+int
+TaskTracker::m_day_key(tm& date)
+{
+    // Normalize the date so tm_wday is valid and the cache key is unique.
+    // Noon keeps the date unchanged by DST changes.
+    date.tm_hour = 12;
+    date.tm_min = 0;
+    date.tm_sec = 0;
+    date.tm_isdst = -1;
+    mktime(&date);
+
+    return (date.tm_year + 1900) * 10000 + (date.tm_mon + 1) * 100 +
+           date.tm_mday;
+}
+
+std::vector<std::pair<Task*, std::string>>
+TaskTracker::m_occurring_tasks(tm date)
+{
+    std::vector<std::pair<Task*, std::string>> occurring;
+
+    for (auto& task : m_tasks) {
+        if (task->occurs(date)) {
+            occurring.emplace_back(task.get(),
+                                   m_create_identifier(date, task.get()));
+        }
+    }
+    return occurring;
+}
+
+std::vector<TaskInstance*>
+TaskTracker::m_cache_day(
+  int key,
+  const std::vector<std::pair<Task*, std::string>>& occurring)
+{
+    std::vector<TaskInstance*> task_instances;
+    task_instances.reserve(occurring.size());
+
+    for (const auto& item : occurring) {
+        task_instances.push_back(m_task_instances.at(item.second).get());
+    }
+
+    std::sort(task_instances.begin(),
+              task_instances.end(),
+              [](const auto& a, const auto& b) {
+                  if (a->get_scheduled_time() == b->get_scheduled_time())
+                    [[unlikely]] {
+                      return a->get_name() < b->get_name();
+                  }
+                  return a->get_scheduled_time() < b->get_scheduled_time();
+              });
+
+    m_day_instances[key] = { m_generation, task_instances };
+    return task_instances;
+}
+
+std::unique_ptr<TaskInstanceData>
+TaskTracker::m_load_task_instance(Task* task,
+                                  tm date,
+                                  const std::string& instance_id)
 {
     auto task_instance_data = m_task_instance_db->get_task(instance_id);
 
@@ -212,36 +603,228 @@ TaskTracker::m_create_task_instance(const std::unique_ptr<Task>& task,
         m_task_instance_db->create_task(
           task->get_id(), instance_id, task->get_name());
         task_instance_data = m_task_instance_db->get_task(instance_id);
-
-        tm start_time = date;
-        start_time.tm_year = date.tm_year;
-        start_time.tm_mday = date.tm_mday;
-        start_time.tm_mon = date.tm_mon;
-        start_time.tm_hour = task->get_scheduled_start_time().hours.count();
-        start_time.tm_min = task->get_scheduled_start_time().minutes.count();
-
-        task_instance_data->scheduled_start = mktime(&start_time);
+        task_instance_data->scheduled_start = m_scheduled_start(task, date);
         m_task_instance_db->update_task(task_instance_data.get());
     }
 
-    task_instance_data = m_task_instance_db->get_task(instance_id);
+    return m_task_instance_db->get_task(instance_id);
+}
+
+void
+TaskTracker::m_add_task_instance(std::unique_ptr<TaskInstanceData> data)
+{
+    const std::string instance_id = data->id;
     auto task_instance = std::make_unique<TaskInstance>(
-      std::move(task_instance_data), m_task_instance_db.get());
+      std::move(data), m_task_instance_db.get());
+    task_instance->set_state_changed_cb([this](const TaskInstance& instance) {
+        m_record_change(ChangeType::InstanceStateChanged,
+                        instance.get_parent_id(),
+                        &instance);
+    });
     m_task_instances.insert({ instance_id, std::move(task_instance) });
 }
 
+time_t
+TaskTracker::m_scheduled_start(Task* task, tm date)
+{
+    const ScheduledTime time = task->get_scheduled_start_time();
+
+    date.tm_hour = time.hours.count();
+    date.tm_min = time.minutes.count();
+    date.tm_sec = 0;
+    date.tm_isdst = -1;
+    return mktime(&date);
+}
+
 void
 TaskTracker::m_load_tasks()
 {
-    m_task_data.clear();
-    m_tasks.clear();
+    const auto database = database_lock();
+    m_task_watermark = m_task_db->last_change();
+
+    auto snapshot = read_task_snapshot(m_snapshot_path, m_task_watermark);
+    auto task_data = snapshot ? std::move(*snapshot) : m_task_db->get_tasks();
+
+    std::vector<std::unique_ptr<Task>> tasks;
+    tasks.reserve(task_data.size());
+    for (const auto& data : task_data) {
+        tasks.push_back(std::make_unique<Task>(data.get(), m_task_db.get()));
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const auto& a, const auto& b) {
+        return a->get_id() < b->get_id();
+    });
+
+    const auto state = lock();
+    m_task_data = std::move(task_data);
+    m_tasks = std::move(tasks);
+    ++m_generation;
+}
+
+std::optional<time_t>
+TaskTracker::m_next_occurrence(Task* task, time_t after)
+{
+    using namespace std::chrono;
+
+    tm after_tm{};
+    localtime_r(&after, &after_tm);
+    year_month_day from(year(after_tm.tm_year + 1900),
+                        month(after_tm.tm_mon + 1),
+                        day(after_tm.tm_mday));
+
+    // The occurrence on the first day may already have started, the one on
+    // any later day hasn't.
+    for (int i = 0; i < 2; ++i) {
+        const auto occurrence = task->next_occurrence(from);
+        if (!occurrence) {
+            return std::nullopt;
+        }
+
+        tm date{};
+        date.tm_year = static_cast<int>(occurrence->year()) - 1900;
+        date.tm_mon = static_cast<unsigned int>(occurrence->month()) - 1;
+        date.tm_mday = static_cast<unsigned int>(occurrence->day());
+
+        const time_t start = m_scheduled_start(task, date);
+        if (start > after) {
+            return start;
+        }
+        from = sys_days{ *occurrence } + days(1);
+    }
+    return std::nullopt;
+}
+
+void
+TaskTracker::m_record_change(ChangeType type,
+                             int task_id,
+                             const TaskInstance* instance)
+{
+    ChangeRecord record{ ++m_change_sequence, m_generation, type, task_id, {},
+                         TaskState::NotStarted };
+    if (instance != nullptr) {
+        record.instance_id = instance->get_uid();
+        record.state = instance->get_data()->state;
+    }
+
+    const size_t index = (record.sequence - 1) % CHANGE_LOG_CAPACITY;
+    if (record.sequence > CHANGE_LOG_CAPACITY) {
+        m_first_change = std::max(m_first_change,
+                                  record.sequence - CHANGE_LOG_CAPACITY + 1);
+    }
+    if (index < m_changes.size()) {
+        m_changes[index] = std::move(record);
+    } else {
+        m_changes.push_back(std::move(record));
+    }
+}
+
+void
+TaskTracker::m_drop_changes(uint64_t sequence)
+{
+    // Once the buffer has wrapped around the dropped records are left in
+    // place to be overwritten. Older records they overwrote stay lost, but
+    // readers that saw up to sequence can still continue from there.
+    m_change_sequence = std::min(m_change_sequence, sequence);
+    m_first_change =
+      std::max<uint64_t>(1, std::min(m_first_change, m_change_sequence + 1));
+    while (m_changes.size() > m_change_sequence) {
+        m_changes.pop_back();
+    }
+}
+
+std::vector<std::unique_ptr<Task>>::iterator
+TaskTracker::m_find_task_position(int id)
+{
+    return std::lower_bound(
+      m_tasks.begin(), m_tasks.end(), id, [](const auto& task, int id) {
+          return task->get_id() < id;
+      });
+}
+
+bool
+TaskTracker::m_sync_tasks()
+{
+    const auto until = m_task_db->last_change();
+    if (until == m_task_watermark) {
+        return false;
+    }
+
+    bool changed = false;
+
+    auto changed_tasks = m_task_db->get_tasks_changed(m_task_watermark, until);
+    const auto deleted_tasks =
+      m_task_db->get_deleted_tasks(m_task_watermark, until);
+
+    const auto state = lock();
+    for (auto& task_data : changed_tasks) {
+        const int id = task_data->id;
+        const auto it = m_find_task_position(id);
+
+        if (it == m_tasks.end() || (*it)->get_id() != id) {
+            m_task_data.push_back(std::move(task_data));
+            m_tasks.insert(it,
+                           std::make_unique<Task>(m_task_data.back().get(),
+                                                  m_task_db.get()));
+            m_record_change(ChangeType::TaskCreated, id);
+            changed = true;
+        } else if (!(*(*it)->get_data() == *task_data)) {
+            *(*it)->get_data() = *task_data;
+            m_record_change(ChangeType::TaskUpdated, id);
+            changed = true;
+        }
+    }
 
-    m_task_data = m_task_db->get_tasks();
+    for (const int id : deleted_tasks) {
+        const auto it = m_find_task_position(id);
+        if (it == m_tasks.end() || (*it)->get_id() != id) {
+            continue;
+        }
 
-    for (const auto& task_data : m_task_data) {
-        m_tasks.push_back(
-          std::make_unique<Task>(task_data.get(), m_task_db.get()));
+        const TaskData* data = (*it)->get_data();
+        m_tasks.erase(it);
+        std::erase_if(m_task_data,
+                      [data](const auto& item) { return item.get() == data; });
+        m_record_change(ChangeType::TaskDeleted, id);
+        changed = true;
     }
+
+    m_task_watermark = until;
+    return changed;
+}
+
+bool
+TaskTracker::m_sync_task_instances()
+{
+    const auto until = m_task_instance_db->last_change();
+    if (until == m_task_instance_watermark) {
+        return false;
+    }
+
+    bool changed = false;
+
+    // Instances that aren't loaded yet are read from the database when
+    // they're first requested, so only the loaded ones need updating.
+    const auto changed_instances =
+      m_task_instance_db->get_tasks_changed(m_task_instance_watermark, until);
+
+    const auto state = lock();
+    for (const auto& instance_data : changed_instances) {
+        const auto it = m_task_instances.find(instance_data->id);
+        if (it != m_task_instances.end() &&
+            !(*it->second->get_data() == *instance_data)) {
+            const bool state_changed =
+              it->second->get_data()->state != instance_data->state;
+            it->second->reload(*instance_data);
+            if (state_changed) {
+                m_record_change(ChangeType::InstanceStateChanged,
+                                instance_data->parent_id,
+                                it->second.get());
+            }
+            changed = true;
+        }
+    }
+
+    m_task_instance_watermark = until;
+    return changed;
 }
 
-} // namespace tasktracker
\ No newline at end of file
+} // namespace tasktracker
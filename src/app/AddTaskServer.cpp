@@ -1,20 +1,55 @@
+#include <algorithm>
+#include <limits>
+
+#include <QDateTime>
 #include <QDebug>
 #include <QHttpServerResponse>
 #include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
+#include <QTcpSocket>
 
 #include "include/AddTaskServer.h"
+#include "include/TaskInstanceStream.h"
+
+RouteMetrics::RouteMetrics(const char* path, const char* method)
+{
+    const std::string labels =
+      std::string("route=\"") + path + "\",method=\"" + method + '"';
+    auto& metrics = tasktracker::Metrics::instance();
+
+    requests = &metrics.counter("tasktracker_http_requests_total",
+                                "HTTP requests received.",
+                                labels);
+    duration = &metrics.histogram("tasktracker_http_request_duration_seconds",
+                                  "Time spent handling HTTP requests.",
+                                  labels);
+}
+
+tasktracker::ScopedMetricTimer
+RouteMetrics::observe() const
+{
+    requests->add();
+    return tasktracker::ScopedMetricTimer(*duration);
+}
 
 TaskServer::TaskServer(tasktracker::TaskTracker* tracker, QObject* parent)
   : QObject(parent)
   , m_tracker(tracker)
-  , m_server(std::make_unique<QHttpServer>())
+  , m_server(new QHttpServer(this))
+  , m_run_prefix(
+      QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 36) + "-")
+  , m_tasks_generation(0)
+  , m_compression_level(COMPRESSION_DEFAULT_LEVEL)
+  , m_compression_threshold(COMPRESSION_DEFAULT_THRESHOLD)
 {
     m_server->route(
       TASK_UPDATE_PATH,
       QHttpServerRequest::Method::Post,
-      [this](const QHttpServerRequest& request) {
+      [this, metrics = RouteMetrics(TASK_UPDATE_PATH, "POST")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
           QJsonParseError err;
           const auto json = QJsonDocument::fromJson(request.body(), &err);
           if (err.error != QJsonParseError::NoError || !json.isObject()) {
@@ -28,7 +63,9 @@ TaskServer::TaskServer(tasktracker::TaskTracker* tracker, QObject* parent)
     m_server->route(
       TASK_UPDATE_PATH,
       QHttpServerRequest::Method::Patch,
-      [this](const QHttpServerRequest& request) {
+      [this, metrics = RouteMetrics(TASK_UPDATE_PATH, "PATCH")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
           QJsonParseError err;
           const auto json = QJsonDocument::fromJson(request.body(), &err);
           if (err.error != QJsonParseError::NoError || !json.isObject()) {
@@ -42,7 +79,9 @@ TaskServer::TaskServer(tasktracker::TaskTracker* tracker, QObject* parent)
     m_server->route(
       TASK_UPDATE_PATH,
       QHttpServerRequest::Method::Delete,
-      [this](const QHttpServerRequest& request) {
+      [this, metrics = RouteMetrics(TASK_UPDATE_PATH, "DELETE")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
           QJsonParseError err;
           const auto json = QJsonDocument::fromJson(request.body(), &err);
           if (err.error != QJsonParseError::NoError || !json.isObject()) {
@@ -53,9 +92,66 @@ TaskServer::TaskServer(tasktracker::TaskTracker* tracker, QObject* parent)
           return this->parseRequest(json.object(), TaskUpdateOperation::Delete);
       });
 
-    m_server->route(TASK_UPDATE_PATH,
-                    QHttpServerRequest::Method::Get,
-                    [this]() { return this->getTasks(); });
+    m_server->route(
+      TASK_BATCH_PATH,
+      QHttpServerRequest::Method::Post,
+      [this, metrics = RouteMetrics(TASK_BATCH_PATH, "POST")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
+          QJsonParseError err;
+          const auto json = QJsonDocument::fromJson(request.body(), &err);
+          if (err.error != QJsonParseError::NoError || !json.isArray()) {
+              QJsonObject obj{ { "error", "Bad request body." } };
+              return QHttpServerResponse(
+                obj, QHttpServerResponse::StatusCode::BadRequest);
+          }
+          return this->parseBatchRequest(json.array());
+      });
+
+    m_server->route(
+      TASK_UPDATE_PATH,
+      QHttpServerRequest::Method::Get,
+      [this, metrics = RouteMetrics(TASK_UPDATE_PATH, "GET")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
+          return this->getTasks(request);
+      });
+
+    m_server->route(
+      INSTANCES_PATH,
+      QHttpServerRequest::Method::Get,
+      [this, metrics = RouteMetrics(INSTANCES_PATH, "GET")](
+        const QHttpServerRequest& request, QHttpServerResponder&& responder) {
+          const auto timer = metrics.observe();
+          this->getInstances(request.query(), std::move(responder));
+      });
+
+    m_server->route(
+      UPCOMING_PATH,
+      QHttpServerRequest::Method::Get,
+      [this, metrics = RouteMetrics(UPCOMING_PATH, "GET")](
+        const QHttpServerRequest& request) {
+          const auto timer = metrics.observe();
+          return this->getUpcoming(request);
+      });
+
+    m_server->route(
+      EVENTS_PATH,
+      QHttpServerRequest::Method::Get,
+      [this, metrics = RouteMetrics(EVENTS_PATH, "GET")](
+        const QHttpServerRequest& request, QHttpServerResponder&& responder) {
+          const auto timer = metrics.observe();
+          this->getEvents(request, std::move(responder));
+      });
+
+    m_server->route(
+      METRICS_PATH, QHttpServerRequest::Method::Get, [this]() {
+          return this->getMetrics();
+      });
+
+    m_events_timer = new QTimer(this);
+    m_events_timer->setInterval(EVENTS_INTERVAL_MS);
+    connect(m_events_timer, &QTimer::timeout, this, &TaskServer::pushEvents);
 }
 
 TaskServer::~TaskServer() {}
@@ -64,6 +160,67 @@ void
 TaskServer::start(quint16 port)
 {
     m_server->listen(QHostAddress::Any, port);
+    m_events_keepalive.start();
+    m_events_timer->start();
+}
+
+void
+TaskServer::setCompression(int level, qsizetype threshold)
+{
+    m_compression_level = level;
+    m_compression_threshold = threshold;
+}
+
+QHttpServerResponse
+TaskServer::jsonResponse(const QHttpServerRequest& request,
+                         const QByteArray& body,
+                         const QByteArray& etag,
+                         std::array<QByteArray, 3>* cache)
+{
+    auto encoding = tasktracker::ContentEncoding::Identity;
+    QByteArray data = body;
+
+    if (body.size() >= m_compression_threshold) {
+        const QByteArray accepted = request.value("Accept-Encoding");
+        encoding = tasktracker::choose_content_encoding(
+          std::string_view(accepted.constData(), accepted.size()));
+    }
+    if (encoding != tasktracker::ContentEncoding::Identity) {
+        const auto index = static_cast<size_t>(encoding);
+        if (cache != nullptr && !(*cache)[index].isNull()) {
+            data = (*cache)[index];
+        } else {
+            const auto compressed = tasktracker::compress(
+              std::string_view(body.constData(), body.size()),
+              encoding,
+              m_compression_level);
+            if (compressed) {
+                data = QByteArray::fromStdString(*compressed);
+                if (cache != nullptr) {
+                    (*cache)[index] = data;
+                }
+            } else {
+                qWarning() << "Compressing the response failed.";
+                encoding = tasktracker::ContentEncoding::Identity;
+            }
+        }
+    }
+
+    QHttpServerResponse response("application/json", data);
+    response.setHeader("Vary", "Accept-Encoding");
+    if (encoding != tasktracker::ContentEncoding::Identity) {
+        const auto name = tasktracker::content_encoding_name(encoding);
+        response.setHeader("Content-Encoding",
+                           QByteArray(name.data(), name.size()));
+    }
+    if (!etag.isEmpty()) {
+        // The compressed body differs byte by byte, so its tag is weak.
+        response.setHeader("ETag",
+                           encoding == tasktracker::ContentEncoding::Identity
+                             ? etag
+                             : "W/" + etag);
+    }
+    return response;
 }
 
 QHttpServerResponse
@@ -78,21 +235,104 @@ TaskServer::parseRequest(const QJsonObject& obj, TaskUpdateOperation op)
           QJsonObject{ { "error", "Request fields incorrect." } },
           QHttpServerResponse::StatusCode::BadRequest);
     }
+    QJsonObject result;
+    {
+        // Keeps other writers out of e.g. the read and write of an update.
+        // Readers only wait for the in-memory part of the change.
+        const auto database = m_tracker->database_lock();
+        result = applyRequest(res.second, op);
+    }
+    if (result.value("error").isString()) {
+        return QHttpServerResponse(result,
+                                   QHttpServerResponse::StatusCode::NotFound);
+    }
+    emit dataModified();
+
+    return QHttpServerResponse(result, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse
+TaskServer::parseBatchRequest(const QJsonArray& array)
+{
+    const QHash<QString, TaskUpdateOperation> operations = {
+        { "create", TaskUpdateOperation::Create },
+        { "update", TaskUpdateOperation::Update },
+        { "delete", TaskUpdateOperation::Delete },
+    };
+    std::vector<std::pair<TaskUpdateOperation, TaskJSONRequest>> requests;
+    requests.reserve(array.size());
+    QJsonArray results;
+    bool valid = true;
+
+    // Validate everything before touching the tracker, so a bad item
+    // doesn't leave the batch half applied.
+    for (const auto& item : array) {
+        const auto obj = item.toObject();
+        const auto op =
+          operations.constFind(obj.value("operation").toString());
+        std::pair<bool, TaskJSONRequest> res{ false, {} };
+
+        if (item.isObject() && op != operations.constEnd()) {
+            res = checkJsonFields(obj, op.value());
+        }
+        if (res.first) {
+            requests.push_back({ op.value(), res.second });
+            results.append(QJsonObject{ { "error", 0 } });
+        } else {
+            valid = false;
+            results.append(
+              QJsonObject{ { "error", "Request fields incorrect." } });
+        }
+    }
+
+    if (!valid) {
+        return QHttpServerResponse(
+          QJsonObject{ { "error", "Request fields incorrect." },
+                       { "results", results } },
+          QHttpServerResponse::StatusCode::BadRequest);
+    }
+
+    results = QJsonArray();
+    try {
+        // Locks the database for the whole batch; readers only wait for the
+        // in-memory part of each change.
+        m_tracker->transaction([this, &requests, &results]() {
+            for (const auto& [op, request] : requests) {
+                results.append(applyRequest(request, op));
+            }
+        });
+    } catch (tasktracker::DatabaseErr& err) {
+        qWarning() << "Batch request failed:" << err.what();
+        emit dataModified();
+        return QHttpServerResponse(
+          QJsonObject{ { "error", "Database error." } },
+          QHttpServerResponse::StatusCode::InternalServerError);
+    }
+    emit dataModified();
+
+    return QHttpServerResponse(
+      QJsonObject{ { "error", 0 }, { "results", results } },
+      QHttpServerResponse::StatusCode::Ok);
+}
+
+QJsonObject
+TaskServer::applyRequest(const TaskJSONRequest& request, TaskUpdateOperation op)
+{
     switch (op) {
-        case TaskUpdateOperation::Create:
-            addTask(res.second);
-            break;
+        case TaskUpdateOperation::Create: {
+            const int id = addTask(request);
+            return QJsonObject{ { "error", 0 }, { "taskID", id } };
+        }
         case TaskUpdateOperation::Update:
-            modifyTask(res.second);
+            if (!modifyTask(request)) {
+                return QJsonObject{ { "error", "Task not found." } };
+            }
             break;
         case TaskUpdateOperation::Delete:
-            deleteTask(res.second);
+            deleteTask(request);
             break;
     }
-    emit dataModified();
-
-    return QHttpServerResponse(QJsonObject{ { "error", 0 } },
-                               QHttpServerResponse::StatusCode::Ok);
+    return QJsonObject{ { "error", 0 } };
 }
 
 std::pair<bool, TaskJSONRequest>
@@ -145,33 +385,39 @@ TaskServer::checkJsonFields(const QJsonObject& obj, TaskUpdateOperation op)
     return { true, requestData };
 }
 
-void
+int
 TaskServer::addTask(const TaskJSONRequest& request)
 {
     std::string name = request.name.toStdString();
-    m_tracker->add_task(name,
-                        (tasktracker::RepeatType)request.repeat_type,
-                        request.repeat_info,
-                        (time_t)request.start_time);
+    return m_tracker->add_task(name,
+                               (tasktracker::RepeatType)request.repeat_type,
+                               request.repeat_info,
+                               (time_t)request.start_time);
 }
 
-void
+bool
 TaskServer::modifyTask(const TaskJSONRequest& request)
 {
     tasktracker::Task* task = m_tracker->get_task(request.id);
-    auto data = task->get_data();
-    data->name =
-      !request.name.isEmpty() ? request.name.toStdString() : data->name;
-    data->repeat_info =
-      request.repeat_info > 0 ? request.repeat_info : data->repeat_info;
-    data->repeat_type =
+    if (task == nullptr) {
+        return false;
+    }
+    // Modified as a copy: readers may be using the task, and modify_task
+    // updates it only while holding the state lock.
+    tasktracker::TaskData data = *task->get_data();
+    data.name =
+      !request.name.isEmpty() ? request.name.toStdString() : data.name;
+    data.repeat_info =
+      request.repeat_info > 0 ? request.repeat_info : data.repeat_info;
+    data.repeat_type =
       request.repeat_type >= 0
         ? static_cast<tasktracker::RepeatType>(request.repeat_type)
-        : data->repeat_type;
-    data->scheduled_start =
-      request.start_time >= 0 ? request.start_time : data->scheduled_start;
+        : data.repeat_type;
+    data.scheduled_start =
+      request.start_time >= 0 ? request.start_time : data.scheduled_start;
 
-    m_tracker->modify_task(data);
+    m_tracker->modify_task(&data);
+    return true;
 }
 
 void
@@ -181,19 +427,429 @@ TaskServer::deleteTask(const TaskJSONRequest& request)
 }
 
 QHttpServerResponse
-TaskServer::getTasks()
+TaskServer::getTasks(const QHttpServerRequest& request)
+{
+    const QUrlQuery query = request.query();
+    std::vector<TaskField> fields = { TaskField::Name,
+                                      TaskField::ID,
+                                      TaskField::Start };
+    tasktracker::TaskFilter filter;
+    size_t limit = std::numeric_limits<size_t>::max();
+    int afterId = 0;
+    bool ok = true;
+
+    if (query.hasQueryItem("limit")) {
+        const int value = query.queryItemValue("limit").toInt(&ok);
+        if (!ok || value <= 0) {
+            return QHttpServerResponse(
+              QJsonObject{ { "error", "Bad value for limit." } },
+              QHttpServerResponse::StatusCode::BadRequest);
+        }
+        limit = value;
+    }
+    if (query.hasQueryItem("after_id")) {
+        afterId = query.queryItemValue("after_id").toInt(&ok);
+        if (!ok) {
+            return QHttpServerResponse(
+              QJsonObject{ { "error", "Bad value for after_id." } },
+              QHttpServerResponse::StatusCode::BadRequest);
+        }
+    }
+    if (query.hasQueryItem("repeat_type")) {
+        const int value = query.queryItemValue("repeat_type").toInt(&ok);
+        if (!ok || value < tasktracker::RepeatType::NoRepeat ||
+            value > tasktracker::RepeatType::WithInterval) {
+            return QHttpServerResponse(
+              QJsonObject{ { "error", "Bad value for repeat_type." } },
+              QHttpServerResponse::StatusCode::BadRequest);
+        }
+        filter.repeat_type = static_cast<tasktracker::RepeatType>(value);
+    }
+    if (query.hasQueryItem("name_prefix")) {
+        filter.name_prefix =
+          query.queryItemValue("name_prefix", QUrl::FullyDecoded)
+            .toStdString();
+    }
+    if (query.hasQueryItem("fields")) {
+        fields.clear();
+        for (const auto& name : query.queryItemValue("fields").split(
+               ',', Qt::SkipEmptyParts)) {
+            const auto field = std::find(std::begin(taskFieldNames),
+                                         std::end(taskFieldNames),
+                                         name.toStdString());
+            if (field == std::end(taskFieldNames)) {
+                return QHttpServerResponse(
+                  QJsonObject{ { "error", "Bad value for fields." } },
+                  QHttpServerResponse::StatusCode::BadRequest);
+            }
+            fields.push_back(static_cast<TaskField>(
+              std::distance(std::begin(taskFieldNames), field)));
+        }
+    }
+
+    const auto lock = m_tracker->lock();
+    const uint64_t generation = m_tracker->generation();
+    const QByteArray etag =
+      '"' + m_run_prefix + QByteArray::number(generation) + '"';
+
+    // Pollers send back the ETag they got; answer them without touching the
+    // task list if nothing changed.
+    for (const auto& tag : request.value("If-None-Match").split(',')) {
+        auto trimmed = tag.trimmed();
+        if (trimmed.startsWith("W/")) {
+            trimmed = trimmed.mid(2);
+        }
+        if (trimmed == etag || trimmed == "*") {
+            QHttpServerResponse response(
+              QHttpServerResponse::StatusCode::NotModified);
+            response.setHeader("ETag", etag);
+            return response;
+        }
+    }
+
+    // Only the plain listing is cached, it's the one dashboards poll.
+    if (!query.isEmpty()) {
+        const auto tasks = m_tracker->find_tasks(filter, afterId, limit);
+        QByteArray body;
+        body.reserve(tasks.size() * TASK_JSON_SIZE_HINT);
+        tasktracker::JsonWriter writer(body);
+
+        writer.begin_array();
+        for (const tasktracker::Task* task : tasks) {
+            writeTask(writer, task, fields);
+        }
+        writer.end_array();
+
+        auto response = jsonResponse(request, body, etag);
+        if (!tasks.empty() && tasks.size() == limit) {
+            QUrlQuery next = query;
+            next.removeAllQueryItems("after_id");
+            next.addQueryItem("after_id",
+                              QString::number(tasks.back()->get_id()));
+            response.setHeader("Link",
+                               "<" TASK_UPDATE_PATH "?" +
+                                 next.toString(QUrl::FullyEncoded).toUtf8() +
+                                 ">; rel=\"next\"");
+        }
+        return response;
+    }
+
+    if (m_tasks_body.isNull() || m_tasks_generation != generation) {
+        const auto tasks = m_tracker->get_tasks();
+        QByteArray body;
+        body.reserve(tasks.size() * TASK_JSON_SIZE_HINT);
+        tasktracker::JsonWriter writer(body);
+
+        writer.begin_array();
+        for (const tasktracker::Task* task : tasks) {
+            writeTask(writer, task, fields);
+        }
+        writer.end_array();
+        m_tasks_body = body;
+        m_tasks_compressed = {};
+        m_tasks_generation = generation;
+    }
+
+    return jsonResponse(request, m_tasks_body, etag, &m_tasks_compressed);
+}
+
+void
+TaskServer::writeTask(tasktracker::JsonWriter<QByteArray>& writer,
+                      const tasktracker::Task* task,
+                      const std::vector<TaskField>& fields)
+{
+    const tasktracker::TaskData* data = task->get_data();
+
+    writer.begin_object();
+    for (const auto field : fields) {
+        writer.key(taskFieldNames[static_cast<size_t>(field)]);
+        switch (field) {
+            case TaskField::Name:
+                writer.value(data->name);
+                break;
+            case TaskField::ID:
+                writer.value(data->id);
+                break;
+            case TaskField::Start:
+                writer.value(data->scheduled_start);
+                break;
+            case TaskField::RepeatType:
+                writer.value(static_cast<int>(data->repeat_type));
+                break;
+            case TaskField::RepeatInfo:
+                writer.value(data->repeat_info);
+                break;
+        }
+    }
+    writer.end_object();
+}
+
+QHttpServerResponse
+TaskServer::getUpcoming(const QHttpServerRequest& request)
+{
+    const QUrlQuery query = request.query();
+    bool ok = true;
+    int count = UPCOMING_DEFAULT_COUNT;
+    time_t after = std::chrono::system_clock::to_time_t(
+      std::chrono::system_clock::now());
+
+    if (query.hasQueryItem("n")) {
+        count = query.queryItemValue("n").toInt(&ok);
+        if (!ok || count < 0 || count > UPCOMING_MAX_COUNT) {
+            return QHttpServerResponse(
+              QJsonObject{ { "error",
+                             "n must be between 0 and " +
+                               QString::number(UPCOMING_MAX_COUNT) + "." } },
+              QHttpServerResponse::StatusCode::BadRequest);
+        }
+    }
+    if (query.hasQueryItem("after")) {
+        after = query.queryItemValue("after").toLongLong(&ok);
+        if (!ok) {
+            return QHttpServerResponse(
+              QJsonObject{ { "error", "Bad value for after." } },
+              QHttpServerResponse::StatusCode::BadRequest);
+        }
+    }
+
+    const auto lock = m_tracker->lock();
+    const auto occurrences = m_tracker->upcoming(count, after);
+    QByteArray body;
+    body.reserve(occurrences.size() * TASK_JSON_SIZE_HINT);
+    tasktracker::JsonWriter writer(body);
+
+    writer.begin_array();
+    for (const auto& occurrence : occurrences) {
+        writer.begin_object()
+          .member("taskName", occurrence.task->get_data()->name)
+          .member("taskID", occurrence.task->get_id())
+          .member("taskStart", occurrence.scheduled_start)
+          .end_object();
+    }
+    writer.end_array();
+
+    return jsonResponse(request, body);
+}
+
+void
+TaskServer::getInstances(const QUrlQuery& query,
+                         QHttpServerResponder&& responder)
+{
+    const QHash<QString, tasktracker::TaskState> states = {
+        { "notstarted", tasktracker::TaskState::NotStarted },
+        { "started", tasktracker::TaskState::Started },
+        { "finished", tasktracker::TaskState::Finished },
+        { "skipped", tasktracker::TaskState::Skipped },
+    };
+    bool from_ok = false;
+    bool to_ok = false;
+    const time_t from = query.queryItemValue("from").toLongLong(&from_ok);
+    const time_t to = query.queryItemValue("to").toLongLong(&to_ok);
+    std::optional<tasktracker::TaskState> state;
+
+    if (!from_ok || !to_ok) {
+        const QJsonObject error{ { "error", "Bad value for from or to." } };
+        responder.write(QJsonDocument(error),
+                        QHttpServerResponder::StatusCode::BadRequest);
+        return;
+    }
+    if (query.hasQueryItem("state")) {
+        const auto it = states.constFind(query.queryItemValue("state"));
+        if (it == states.constEnd()) {
+            responder.write(
+              QJsonDocument(QJsonObject{ { "error", "Bad value for state." } }),
+              QHttpServerResponder::StatusCode::BadRequest);
+            return;
+        }
+        state = it.value();
+    }
+
+    // The responder takes ownership of the stream and reads it as the
+    // socket drains.
+    responder.write(new TaskInstanceStream(m_tracker, from, to, state),
+                    "application/json");
+}
+
+void
+TaskServer::getEvents(const QHttpServerRequest& request,
+                      QHttpServerResponder&& responder)
+{
+    // Reconnecting EventSources send the ID of the last event they got.
+    QByteArray last = request.value("Last-Event-ID");
+    if (last.isEmpty()) {
+        last = request.query().queryItemValue("after").toUtf8();
+    }
+    // The IDs carry the run prefix, as the sequence starts over on every
+    // run. An ID of another run, or one that doesn't parse, can't be
+    // continued from.
+    uint64_t sequence = 0;
+    bool reset = false;
+    if (last.isEmpty()) {
+        const auto lock = m_tracker->lock();
+        sequence = m_tracker->last_change_sequence();
+    } else if (last.startsWith(m_run_prefix)) {
+        bool ok = false;
+        sequence = last.mid(m_run_prefix.size()).toULongLong(&ok);
+        reset = !ok;
+    } else {
+        reset = true;
+    }
+
+    if (m_event_clients.size() >= EVENTS_MAX_CLIENTS) {
+        dropEventClient(m_event_clients.begin());
+    }
+
+    responder.writeStatusLine(QHttpServerResponder::StatusCode::Ok);
+    responder.writeHeaders({ { "Content-Type", "text/event-stream" },
+                             { "Cache-Control", "no-cache" } });
+    responder.writeBody("retry: 3000\n\n");
+
+    QTcpSocket* socket = responder.socket();
+    m_event_clients.push_back({ std::move(responder), sequence, reset, {} });
+    // The socket is still alive while disconnected is emitted, so the
+    // responder can be destroyed right away.
+    m_event_clients.back().disconnected =
+      connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+          m_event_clients.remove_if([socket](const EventClient& client) {
+              return client.responder.socket() == socket;
+          });
+      });
+
+    if (!writeEvents(m_event_clients.back())) {
+        dropEventClient(std::prev(m_event_clients.end()));
+    }
+}
+
+void
+TaskServer::pushEvents()
+{
+    if (m_event_clients.empty()) {
+        return;
+    }
+
+    const bool keepalive = m_events_keepalive.hasExpired(EVENTS_KEEPALIVE_MS);
+    if (keepalive) {
+        m_events_keepalive.restart();
+    }
+
+    for (auto it = m_event_clients.begin(); it != m_event_clients.end();) {
+        if (!writeEvents(*it)) {
+            it = dropEventClient(it);
+            continue;
+        }
+        if (keepalive) {
+            it->responder.writeBody(": keepalive\n\n");
+        }
+        ++it;
+    }
+}
+
+std::list<TaskServer::EventClient>::iterator
+TaskServer::dropEventClient(std::list<EventClient>::iterator client)
+{
+    // Disconnected first, so aborting doesn't remove the client while it's
+    // being erased here.
+    disconnect(client->disconnected);
+    client->responder.socket()->abort();
+    return m_event_clients.erase(client);
+}
+
+bool
+TaskServer::writeEvents(EventClient& client)
+{
+    // Nothing more is queued for a client that doesn't read what it gets.
+    // An EventSource reconnects with Last-Event-ID and continues from
+    // there, or gets a reset if it fell out of the change log.
+    if (client.responder.socket()->bytesToWrite() > EVENTS_MAX_PENDING_BYTES) {
+        qWarning() << "Dropping an event stream with"
+                   << client.responder.socket()->bytesToWrite()
+                   << "bytes unsent.";
+        return false;
+    }
+
+    static const std::string_view types[] = { "taskCreated",
+                                              "taskUpdated",
+                                              "taskDeleted",
+                                              "instanceStateChanged",
+                                              "reset" };
+    QByteArray body;
+    uint64_t generation = 0;
+
+    {
+        const auto lock = m_tracker->lock();
+        const auto changes = client.reset
+                               ? std::nullopt
+                               : m_tracker->get_changes(client.sequence);
+
+        if (!changes) {
+            // The client missed records that were already dropped from the
+            // log or made by another run, it has to fetch everything again.
+            client.sequence = m_tracker->last_change_sequence();
+            client.reset = false;
+            generation = m_tracker->generation();
+        } else if (changes->empty()) {
+            return true;
+        } else {
+            for (const auto& change : *changes) {
+                body.append("id: " + m_run_prefix +
+                            QByteArray::number(change.sequence) +
+                            "\nevent: ");
+                const auto type = types[static_cast<size_t>(change.type)];
+                body.append(type.data(), type.size());
+                body.append("\ndata: ");
+
+                tasktracker::JsonWriter writer(body);
+                writer.begin_object()
+                  .member("taskID", change.task_id)
+                  .member("generation", change.generation);
+                if (change.type ==
+                    tasktracker::ChangeType::InstanceStateChanged) {
+                    writer.member("instanceID", change.instance_id)
+                      .member("state", static_cast<int>(change.state));
+                }
+                writer.end_object();
+                body.append("\n\n");
+            }
+            client.sequence = changes->back().sequence;
+        }
+    }
+
+    if (body.isEmpty()) {
+        body = "id: " + m_run_prefix + QByteArray::number(client.sequence) +
+               "\nevent: reset\ndata: {\"generation\":" +
+               QByteArray::number(generation) + "}\n\n";
+    }
+    client.responder.writeBody(body);
+    return true;
+}
+
+QHttpServerResponse
+TaskServer::getMetrics()
 {
-    QVariantList resp;
+    std::string body;
+    body.reserve(16 * 1024);
+    tasktracker::Metrics::instance().write(body);
 
-    for (const tasktracker::Task* task : m_tracker->get_tasks()) {
-        QVariantMap map = {
-            { "taskName", QString::fromStdString(task->get_name()) },
-            { "taskID", task->get_id() },
-            { "taskStart",
-              static_cast<qint64>(task->get_scheduled_start_time_t()) },
-        };
-        resp.append(map);
+    size_t cached_days = 0;
+    size_t tasks = 0;
+    {
+        const auto lock = m_tracker->lock();
+        cached_days = m_tracker->cached_days();
+        tasks = m_tracker->get_tasks().size();
     }
+    const auto gauge = [&body](const char* name, const char* help, size_t v) {
+        body += std::string("# HELP ") + name + " " + help + "\n";
+        body += std::string("# TYPE ") + name + " gauge\n";
+        body += std::string(name) + " " + std::to_string(v) + "\n";
+    };
+    gauge("tasktracker_tasks", "Tasks in the tracker.", tasks);
+    gauge("tasktracker_instance_cache_days",
+          "Days of task instances held in memory.",
+          cached_days);
+    gauge("tasktracker_event_clients",
+          "Open GET /events streams.",
+          m_event_clients.size());
 
-    return { QJsonArray::fromVariantList(resp) };
+    return QHttpServerResponse("text/plain; version=0.0.4",
+                               QByteArray::fromStdString(body));
 }
@@ -1,5 +1,29 @@
 #include "DeviceListModel.h"
 #include <QDebug>
+#include <unordered_set>
+
+QuickNotify::QuickNotify(QObject* parent)
+  : QObject(parent)
+  , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(NOTIFY_COALESCE_MS);
+    connect(m_timer, &QTimer::timeout, this, [this]() {
+        // Cleared first so events during the handlers notify again.
+        m_pending = false;
+        emit notify();
+    });
+}
+
+void
+QuickNotify::notify_slot()
+{
+    if (m_pending.exchange(true)) {
+        return;
+    }
+    QMetaObject::invokeMethod(
+      this, [this]() { m_timer->start(); }, Qt::QueuedConnection);
+}
 
 QList<QString>
 unconnected_devices(BoredomScheduler* scheduler)
@@ -54,13 +78,44 @@ DeviceListModel::data(const QModelIndex& index, int role) const
 void
 DeviceListModel::populate()
 {
-    beginResetModel();
-    bool old_alarmv = isAlarm();
-    m_devices = unconnected_devices(m_scheduler);
-    if (isAlarm() != old_alarmv) {
+    const bool old_alarm = isAlarm();
+    const auto devices = unconnected_devices(m_scheduler);
+    const std::unordered_set<QString> wanted(devices.begin(), devices.end());
+
+    // The names are the keys, so the diff needs them to be unique.
+    if (wanted.size() != size_t(devices.size())) {
+        beginResetModel();
+        m_devices = devices;
+        endResetModel();
+    } else {
+        for (qsizetype row = m_devices.size() - 1; row >= 0; --row) {
+            if (!wanted.count(m_devices.at(row))) {
+                beginRemoveRows(QModelIndex(), row, row);
+                m_devices.removeAt(row);
+                endRemoveRows();
+            }
+        }
+        // Devices still listed keep their order, so new ones can be
+        // inserted where they are in the new list.
+        const std::unordered_set<QString> present(m_devices.begin(),
+                                                  m_devices.end());
+        for (qsizetype row = 0; row < devices.size(); ++row) {
+            if (!present.count(devices.at(row))) {
+                beginInsertRows(QModelIndex(), row, row);
+                m_devices.insert(row, devices.at(row));
+                endInsertRows();
+            }
+        }
+    }
+
+    if (isAlarm() != old_alarm) {
         emit isAlarmChanged(isAlarm());
+        if (!m_devices.isEmpty()) {
+            emit dataChanged(createIndex(0, 0),
+                             createIndex(m_devices.size() - 1, 0),
+                             { DeviceAlarmRole });
+        }
     }
-    endResetModel();
 }
 
 QHash<int, QByteArray>
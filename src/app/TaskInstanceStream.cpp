@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstring>
+
+#include "include/TaskInstanceStream.h"
+
+TaskInstanceStream::TaskInstanceStream(
+  tasktracker::TaskTracker* tracker,
+  time_t from,
+  time_t to,
+  std::optional<tasktracker::TaskState> state,
+  QObject* parent)
+  : QIODevice(parent)
+  , m_tracker(tracker)
+  , m_from(from)
+  , m_to(to)
+  , m_state(state)
+{
+    m_buffer.reserve(TASK_INSTANCE_STREAM_PAGE * TASK_INSTANCE_JSON_SIZE_HINT);
+    open(QIODevice::ReadOnly);
+    fillBuffer();
+}
+
+bool
+TaskInstanceStream::isSequential() const
+{
+    return true;
+}
+
+qint64
+TaskInstanceStream::bytesAvailable() const
+{
+    return (m_buffer.size() - m_offset) + QIODevice::bytesAvailable();
+}
+
+bool
+TaskInstanceStream::atEnd() const
+{
+    return m_finished && m_offset >= m_buffer.size() &&
+           QIODevice::bytesAvailable() == 0;
+}
+
+qint64
+TaskInstanceStream::readData(char* data, qint64 maxlen)
+{
+    if (m_offset >= m_buffer.size()) {
+        fillBuffer();
+    }
+    if (m_offset >= m_buffer.size()) {
+        return -1;
+    }
+
+    const qint64 size = std::min<qint64>(maxlen, m_buffer.size() - m_offset);
+    memcpy(data, m_buffer.constData() + m_offset, size);
+    m_offset += size;
+
+    // Keep the next page ready so bytesAvailable() doesn't drop to zero
+    // before the end.
+    if (m_offset >= m_buffer.size()) {
+        fillBuffer();
+    }
+    return size;
+}
+
+qint64
+TaskInstanceStream::writeData(const char* data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
+
+void
+TaskInstanceStream::fillBuffer()
+{
+    if (m_finished) {
+        return;
+    }
+
+    const bool first = m_last == nullptr;
+    // Locks the database itself; memory isn't touched.
+    auto page = m_tracker->get_task_instance_page(
+      m_from, m_to, m_state, m_last.get(), TASK_INSTANCE_STREAM_PAGE);
+
+    // Keeps the capacity, the same buffer is reused for every page.
+    m_buffer.resize(0);
+    m_offset = 0;
+
+    tasktracker::JsonWriter writer(m_buffer);
+    if (first) {
+        writer.begin_array();
+    } else if (!page.empty()) {
+        m_buffer.append(',');
+    }
+
+    for (const auto& instance : page) {
+        writer.begin_object()
+          .member("id", instance->id)
+          .member("taskID", instance->parent_id)
+          .member("taskName", instance->name)
+          .member("scheduledStart", instance->scheduled_start)
+          .member("startTime", instance->start_time)
+          .member("finishTime", instance->finish_time)
+          .member("timeSpent", instance->time_spent.count())
+          .member("comment", instance->comment)
+          .member("state", static_cast<int>(instance->state))
+          .end_object();
+    }
+
+    if (page.size() < TASK_INSTANCE_STREAM_PAGE) {
+        writer.end_array();
+        m_finished = true;
+    } else {
+        m_last = std::move(page.back());
+    }
+}
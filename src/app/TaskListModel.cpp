@@ -1,11 +1,20 @@
 #include "TaskListModel.h"
 #include <QDebug>
+#include <algorithm>
+#include <metrics.h>
 #include <time.h>
+#include <unordered_set>
 
 TaskListModel::TaskListModel(tasktracker::TaskTracker* tracker, QObject* parent)
   : QAbstractListModel{ parent }
   , m_tracker{ tracker }
+  , m_refresh_timer{ new QTimer(this) }
 {
+    m_prefetch_pool.setMaxThreadCount(1);
+    m_refresh_timer->setSingleShot(true);
+    m_refresh_timer->setInterval(REFRESH_COALESCE_MS);
+    connect(
+      m_refresh_timer, &QTimer::timeout, this, &TaskListModel::refresh);
     setToday();
 }
 
@@ -13,118 +22,271 @@ int
 TaskListModel::rowCount(const QModelIndex& parent) const
 {
     Q_UNUSED(parent)
-    return m_active_task_instance_list.size();
+    return m_rows.size();
 }
 
 QVariant
 TaskListModel::data(const QModelIndex& index, int role) const
 {
-    if (index.row() < 0 || index.row() >= m_active_task_instance_list.size()) {
+    if (index.row() < 0 || index.row() >= m_rows.size()) {
         return QVariant();
     }
 
-    auto current_task = m_active_task_instance_list.at(index.row());
-    std::stringstream time_ss;
-    tm* start_tm{};
-    time_t start_time_t{};
+    const auto& row = m_rows.at(index.row());
 
     switch ((TaskListRole)role) {
         case TaskNameRole:
-            return QString(current_task->get_name().c_str());
+            return row.name;
         case TaskStartTimeRole:
-            start_time_t = current_task->get_scheduled_time();
-            start_tm = localtime(&start_time_t);
-            if (start_tm->tm_hour < 10) {
-                time_ss << "0";
-            }
-            time_ss << start_tm->tm_hour << ":";
-
-            if (start_tm->tm_min < 10) {
-                time_ss << "0";
-            }
-
-            time_ss << start_tm->tm_min;
-            return QString(time_ss.str().c_str());
+            return row.start_time;
         case TaskFinishedRole:
-            return current_task->is_finished();
+            return row.finished;
         case TaskSkippedRole:
-            return current_task->is_skipped();
+            return row.skipped;
         case TaskStartedRole:
-            return current_task->is_started();
+            return row.started;
         default:
             return QVariant();
     }
 }
 
+TaskListModel::TaskRow
+TaskListModel::makeRow(tasktracker::TaskInstance* instance)
+{
+    const time_t start = instance->get_scheduled_time();
+    tm start_tm{};
+    localtime_r(&start, &start_tm);
+
+    return { instance,
+             instance->get_uid(),
+             QString::fromStdString(instance->get_name()),
+             QStringLiteral("%1:%2")
+               .arg(start_tm.tm_hour, 2, 10, QLatin1Char('0'))
+               .arg(start_tm.tm_min, 2, 10, QLatin1Char('0')),
+             instance->is_finished(),
+             instance->is_skipped(),
+             instance->is_started() };
+}
+
+QList<int>
+TaskListModel::changedRoles(const TaskRow& a, const TaskRow& b)
+{
+    QList<int> roles;
+    if (a.name != b.name) {
+        roles.append(TaskNameRole);
+    }
+    if (a.start_time != b.start_time) {
+        roles.append(TaskStartTimeRole);
+    }
+    if (a.finished != b.finished) {
+        roles.append(TaskFinishedRole);
+    }
+    if (a.skipped != b.skipped) {
+        roles.append(TaskSkippedRole);
+    }
+    if (a.started != b.started) {
+        roles.append(TaskStartedRole);
+    }
+    return roles;
+}
+
 void
-TaskListModel::setFinished(int index)
+TaskListModel::changeState(int index,
+                           void (tasktracker::TaskInstance::*change)())
 {
-    if (index >= 0 && index < m_active_task_instance_list.size()) {
-        m_active_task_instance_list.at(index)->finish_task();
+    // The state is written to the database, which is locked first.
+    const auto database = m_tracker->database_lock();
+    const auto lock = m_tracker->lock();
+    if (index < 0 || index >= m_rows.size() ||
+        m_tracker->generation() != m_generation) {
+        return;
     }
 
-    emit dataChanged(createIndex(index, 0),
-                     createIndex(index, 0),
-                     { TaskFinishedRole, TaskSkippedRole, TaskStartedRole });
+    auto& row = m_rows[index];
+    (row.instance->*change)();
+    const auto updated = makeRow(row.instance);
+    const auto roles = changedRoles(row, updated);
+    row = updated;
+
+    if (!roles.isEmpty()) {
+        emit dataChanged(createIndex(index, 0), createIndex(index, 0), roles);
+    }
 }
 
 void
-TaskListModel::setUndone(int index)
+TaskListModel::setFinished(int index)
 {
-    if (index >= 0 && index < m_active_task_instance_list.size()) {
-        m_active_task_instance_list.at(index)->set_undone();
-    }
+    changeState(index, &tasktracker::TaskInstance::finish_task);
+}
 
-    emit dataChanged(createIndex(index, 0),
-                     createIndex(index, 0),
-                     { TaskFinishedRole, TaskSkippedRole, TaskStartedRole });
+void
+TaskListModel::setUndone(int index)
+{
+    changeState(index, &tasktracker::TaskInstance::set_undone);
 }
 
 void
 TaskListModel::removeTask(int index)
 {
-    if (index >= 0 && index < m_active_task_instance_list.size()) {
-        m_tracker->delete_task(
-          m_active_task_instance_list.at(index)->get_parent_id());
+    int id = 0;
+    {
+        const auto lock = m_tracker->lock();
+        if (index >= 0 && index < m_rows.size() &&
+            m_tracker->generation() == m_generation) {
+            id = m_rows.at(index).instance->get_parent_id();
+        }
+    }
+    // Locks the database itself, and memory only while removing the task.
+    if (id != 0) {
+        m_tracker->delete_task(id);
     }
 
-    emit dataChanged(createIndex(index, 0),
-                     createIndex(index, 0),
-                     { TaskFinishedRole, TaskSkippedRole, TaskStartedRole });
+    // The task's rows are removed by the diff in populate.
     refresh();
 }
 
 void
 TaskListModel::setSkipped(int index)
 {
-    if (index >= 0 && index < m_active_task_instance_list.size()) {
-        m_active_task_instance_list.at(index)->skip_task();
-    }
-
-    emit dataChanged(createIndex(index, 0),
-                     createIndex(index, 0),
-                     { TaskFinishedRole, TaskSkippedRole, TaskStartedRole });
+    changeState(index, &tasktracker::TaskInstance::skip_task);
 }
 
 void
 TaskListModel::refresh()
 {
-    auto now = std::chrono::system_clock::now();
-    m_date = std::chrono::system_clock::to_time_t(now);
+    m_refresh_timer->stop();
     populate();
 }
 
+void
+TaskListModel::scheduleRefresh()
+{
+    if (!m_refresh_timer->isActive()) {
+        m_refresh_timer->start();
+    }
+}
+
 void
 TaskListModel::populate()
 {
-    beginResetModel();
-    const auto tasks = m_tracker->get_task_instances(*localtime(&m_date));
-    m_active_task_instance_list.clear();
-    m_active_task_instance_list.reserve(tasks.size());
-    std::copy(tasks.begin(),
-              tasks.end(),
-              std::back_inserter(m_active_task_instance_list));
-    endResetModel();
+    static auto& duration = tasktracker::Metrics::instance().histogram(
+      "tasktracker_model_populate_seconds",
+      "Time spent loading a day into the task list model.");
+    const tasktracker::ScopedMetricTimer timer(duration);
+    tm date{};
+    localtime_r(&m_date, &date);
+    std::unique_lock<std::recursive_mutex> database;
+    auto lock = m_tracker->lock();
+    if (!m_tracker->is_day_loaded(date)) {
+        // Loading the day writes to the database, which is locked first.
+        // Only then does the GUI wait for writes of the API.
+        lock.unlock();
+        database = m_tracker->database_lock();
+        lock.lock();
+    }
+    const auto tasks = m_tracker->get_task_instances(date);
+    m_generation = m_tracker->generation();
+
+    // Rows are matched by instance uid rather than by pointer: if the
+    // generation changed, the old instances may already be deleted.
+    std::vector<TaskRow> rows;
+    rows.reserve(tasks.size());
+    std::unordered_set<std::string> wanted;
+    for (auto* task : tasks) {
+        rows.push_back(makeRow(task));
+        wanted.insert(rows.back().key);
+    }
+
+    // Remove rows of instances that are gone, a contiguous range at a time
+    // from the end.
+    for (qsizetype row = m_rows.size() - 1; row >= 0; --row) {
+        if (wanted.count(m_rows.at(row).key)) {
+            continue;
+        }
+        qsizetype first = row;
+        while (first > 0 && !wanted.count(m_rows.at(first - 1).key)) {
+            --first;
+        }
+        beginRemoveRows(QModelIndex(), first, row);
+        m_rows.remove(first, row - first + 1);
+        endRemoveRows();
+        row = first;
+    }
+
+    // The remaining rows are a subset of the new ones; move them into
+    // place and insert the new ones around them.
+    std::unordered_set<std::string> present;
+    for (const auto& row : m_rows) {
+        present.insert(row.key);
+    }
+    for (qsizetype row = 0; row < qsizetype(rows.size()); ++row) {
+        if (!present.count(rows[row].key)) {
+            qsizetype last = row;
+            while (last + 1 < qsizetype(rows.size()) &&
+                   !present.count(rows[last + 1].key)) {
+                ++last;
+            }
+            beginInsertRows(QModelIndex(), row, last);
+            for (qsizetype i = row; i <= last; ++i) {
+                m_rows.insert(i, std::move(rows[i]));
+            }
+            endInsertRows();
+            row = last;
+            continue;
+        }
+
+        const auto& key = rows[row].key;
+        const auto it = std::find_if(
+          m_rows.begin() + row, m_rows.end(), [&key](const TaskRow& r) {
+              return r.key == key;
+          });
+        const qsizetype from = it - m_rows.begin();
+        if (from != row) {
+            beginMoveRows(QModelIndex(), from, from, QModelIndex(), row);
+            m_rows.move(from, row);
+            endMoveRows();
+        }
+
+        const auto roles = changedRoles(m_rows.at(row), rows[row]);
+        m_rows[row] = std::move(rows[row]);
+        if (!roles.isEmpty()) {
+            emit dataChanged(createIndex(row, 0), createIndex(row, 0), roles);
+        }
+    }
+
+    // Also after refreshes: a new generation invalidated the cached days.
+    prefetch();
+}
+
+void
+TaskListModel::prefetch()
+{
+    const uint64_t token = ++m_prefetch_token;
+    const time_t date = m_date;
+
+    m_prefetch_pool.start([this, token, date]() {
+        // Nearest days first. get_task_instances reads the instances from
+        // the database without holding the state lock, so the GUI thread
+        // only waits while a day's instances are added to memory.
+        for (int offset = 1; offset <= PREFETCH_DAYS; ++offset) {
+            for (const int sign : { 1, -1 }) {
+                if (m_prefetch_token != token) {
+                    return;
+                }
+                const time_t day = date + sign * offset * 24 * 60 * 60;
+                tm day_tm{};
+                localtime_r(&day, &day_tm);
+                m_tracker->get_task_instances(day_tm);
+            }
+        }
+    });
+}
+
+void
+TaskListModel::stopPrefetch()
+{
+    ++m_prefetch_token;
+    m_prefetch_pool.waitForDone();
 }
 
 QHash<int, QByteArray>
@@ -176,7 +338,8 @@ TaskListModel::date()
 QDate
 TaskListModel::currentDate()
 {
-    tm date = *localtime(&m_date);
+    tm date{};
+    localtime_r(&m_date, &date);
 
     return QDate{ date.tm_year + 1900, date.tm_mon + 1, date.tm_mday };
 }
\ No newline at end of file
@@ -1,138 +1,81 @@
 #include "WeatherListModel.h"
-#include <stdio.h>
-
-std::string
-read_weather(const std::string& command,
-             std::string& location,
-             std::string& utc_diff)
-{
-    std::stringstream ss;
-    char buffer[2048];
-    FILE* in;
-    auto cmd =
-      (command + " --csv --timezone " + utc_diff + " --city " + location);
-    if (!(in = popen(cmd.c_str(), "r"))) {
-        exit(1);
-    }
-
-    while (fgets(buffer, sizeof(buffer), in) != NULL) {
-        ss << buffer;
-    }
-    pclose(in);
-    return ss.str();
-}
-
-static std::vector<std::string>
-split(std::string parsestr, std::string delimiter, bool has_header = false)
-{
-    std::vector<std::string> output_lines;
-
-    size_t pos = 0;
-    std::string token;
-    bool header = has_header;
-
-    while ((pos = parsestr.find(delimiter)) != std::string::npos) {
-        token = parsestr.substr(0, pos);
-        if (!header) {
-            output_lines.push_back(token);
-        } else {
-            header = false;
-        }
-        parsestr.erase(0, pos + delimiter.length());
-    }
-    return output_lines;
-}
-
-static std::vector<std::vector<std::string>>
-split_api_output(std::string parsestr)
-{
-    std::vector<std::vector<std::string>> output;
-    auto lines = split(parsestr, "\n", true);
-    for (auto line : lines) {
-        output.push_back(split(line, ","));
-    }
-    return output;
-}
-
-QString
-get_time_value(const std::string& data)
-{
-    return QString::fromStdString(split(data, " ").at(0));
-}
-
-QString
-get_date_value(const std::string& data)
-{
-    return QString::fromStdString(split(data, " ").at(1));
-}
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QThreadPool>
 
 WeatherListModel::WeatherListModel(std::filesystem::path weather_csv_program,
                                    std::string location,
                                    int utc_diff,
+                                   std::filesystem::path cache_path,
                                    QObject* parent)
   : QAbstractListModel{ parent }
   , m_weather_program{ weather_csv_program }
+  , m_cache_path{ cache_path }
   , m_location{ location }
   , m_utc_diff{ utc_diff }
 {
+    m_process = new QProcess(this);
+    connect(m_process,
+            &QProcess::finished,
+            this,
+            &WeatherListModel::fetchFinished);
+    connect(m_process,
+            &QProcess::errorOccurred,
+            this,
+            [this](QProcess::ProcessError error) {
+                if (error == QProcess::FailedToStart) {
+                    // finished isn't emitted, so nothing else stops it.
+                    m_fetch_timeout->stop();
+                    qWarning() << "Starting the weather program failed.";
+                }
+            });
+
+    m_fetch_timeout = new QTimer(this);
+    m_fetch_timeout->setSingleShot(true);
+    m_fetch_timeout->setInterval(WEATHER_FETCH_TIMEOUT_MS);
+    connect(m_fetch_timeout, &QTimer::timeout, this, [this]() {
+        qWarning() << "The weather program timed out.";
+        m_process->kill();
+    });
+
     m_timer = new QTimer(parent);
-    m_timer->setInterval(m_refresh_time_s * 1000);
-    connect(m_timer, &QTimer::timeout, this, &WeatherListModel::populate);
-    m_timer->start();
+    connect(m_timer, &QTimer::timeout, this, [this]() {
+        // The first interval may have been shortened by populate.
+        m_timer->setInterval(m_refresh_time_s * 1000);
+        fetch();
+    });
 }
 
 int
 WeatherListModel::rowCount(const QModelIndex& parent) const
 {
     Q_UNUSED(parent);
-    return m_api_output_lines.size() - 1;
-}
-
-QString
-get_rain_ammount(const std::vector<std::vector<std::string>>& data, int index)
-{
-    float previous = 0;
-    if (index > 0) {
-        previous = std::atof(data.at(index - 1).at(4).c_str());
-    }
-    float current = std::atof(data.at(index).at(4).c_str());
-    QString text;
-    QTextStream stream{ &text };
-    stream.setRealNumberPrecision(2);
-    stream << (current - previous);
-
-    return text;
+    return m_rows.size();
 }
 
 QVariant
 WeatherListModel::data(const QModelIndex& index, int role) const
 {
-    // time,date,temperature,rain,clouds,wind,
-    if (index.row() >= m_api_output_lines.size() - 1) {
-        return QVariant();
-    }
-    if (m_api_output_lines.at(index.row()).size() < 7) {
+    if (index.row() < 0 || index.row() >= rowCount()) {
         return QVariant();
     }
+    const auto& row = m_rows[index.row()];
 
     switch (role) {
         case TimeRole:
-            return QString::fromStdString(
-              m_api_output_lines.at(index.row()).at(1));
+            return row.time;
         case DateRole:
-            return QString::fromStdString(
-              m_api_output_lines.at(index.row()).at(2));
+            return row.date;
         case TemperatureRole:
-            return QString::fromStdString(
-              m_api_output_lines.at(index.row()).at(3));
+            return row.temperature_text;
         case RainRole:
-            return get_rain_ammount(m_api_output_lines, index.row());
+            return row.rain_text;
         case CloudsRole:
-            return QString::fromStdString(
-              m_api_output_lines.at(index.row()).at(5));
+            return row.clouds_text;
         case WindRole:
-            return QString::fromStdString(
-              m_api_output_lines.at(index.row()).at(6));
+            return row.wind_text;
         default:
             return QVariant();
     }
@@ -141,13 +84,155 @@ WeatherListModel::data(const QModelIndex& index, int role) const
 void
 WeatherListModel::populate()
 {
-    beginResetModel();
-    auto utc_diff = std::to_string(m_utc_diff);
-    m_api_output = read_weather(m_weather_program, m_location, utc_diff);
-    m_api_output_lines = split_api_output(m_api_output);
+    const auto fetched = loadCache();
+    const qint64 age =
+      fetched ? QDateTime::currentSecsSinceEpoch() - *fetched : -1;
+
+    if (age >= 0 && age < m_refresh_time_s) {
+        m_timer->start((m_refresh_time_s - age) * 1000);
+        return;
+    }
+    m_timer->start(m_refresh_time_s * 1000);
+    fetch();
+}
+
+void
+WeatherListModel::fetch()
+{
+    if (m_process->state() != QProcess::NotRunning) {
+        return;
+    }
+
+    m_process->start(QString::fromStdString(m_weather_program.string()),
+                     { "--csv",
+                       "--timezone",
+                       QString::number(m_utc_diff),
+                       "--city",
+                       QString::fromStdString(m_location) });
+    m_fetch_timeout->start();
+}
+
+void
+WeatherListModel::fetchFinished(int exit_code, QProcess::ExitStatus status)
+{
+    m_fetch_timeout->stop();
+    const QByteArray output = m_process->readAllStandardOutput();
+    if (status != QProcess::NormalExit || exit_code != 0) {
+        qWarning() << "Fetching the weather failed, exit code" << exit_code;
+        return;
+    }
+
+    const QByteArray header =
+      QByteArray::number(QDateTime::currentSecsSinceEpoch()) + ' ' +
+      cacheKey() + '\n';
+
+    // The global pool is waited for when the application is destroyed,
+    // before the model as its child is.
+    QThreadPool::globalInstance()->start([this, output, header]() {
+        auto rows = makeRows(tasktracker::CsvTable(output.toStdString()));
+        if (!rows.empty() && !m_cache_path.empty()) {
+            // Atomically replaced, so a crash can't leave half a cache.
+            QSaveFile file(QString::fromStdString(m_cache_path.string()));
+            if (file.open(QIODevice::WriteOnly)) {
+                file.write(header);
+                file.write(output);
+                file.commit();
+            }
+            if (file.error() != QFileDevice::NoError) {
+                qWarning() << "Saving the weather cache failed:"
+                           << file.errorString();
+            }
+        }
+        QMetaObject::invokeMethod(
+          this,
+          [this, rows = std::move(rows)]() mutable {
+              setRows(std::move(rows));
+          },
+          Qt::QueuedConnection);
+    });
+}
+
+std::optional<qint64>
+WeatherListModel::loadCache()
+{
+    if (m_cache_path.empty()) {
+        return std::nullopt;
+    }
+    QFile file(QString::fromStdString(m_cache_path.string()));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    // The fetch time and cacheKey on the first line, then the program's
+    // output.
+    const QByteArray header = file.readLine().trimmed();
+    const qsizetype space = header.indexOf(' ');
+    bool ok = false;
+    const qint64 fetched = header.left(space).toLongLong(&ok);
+    if (space < 0 || !ok) {
+        qWarning() << "Ignoring a malformed weather cache.";
+        return std::nullopt;
+    }
+    if (header.mid(space + 1) != cacheKey()) {
+        // The city or timezone was changed, the forecast is fetched again.
+        qDebug() << "Ignoring the weather cache of another location.";
+        return std::nullopt;
+    }
+    setRows(makeRows(tasktracker::CsvTable(file.readAll().toStdString())));
+    return fetched;
+}
+
+QByteArray
+WeatherListModel::cacheKey() const
+{
+    // The location is last, as it may contain spaces.
+    return QByteArray::number(m_utc_diff) + ' ' +
+           QByteArray::fromStdString(m_location).trimmed();
+}
 
-    std::string parsestr = m_api_output;
+std::vector<WeatherListModel::WeatherRow>
+WeatherListModel::makeRows(const tasktracker::CsvTable& table)
+{
+    const auto text = [](std::string_view field) {
+        return QString::fromUtf8(field.data(), field.size());
+    };
+    const auto number = [](std::string_view field) {
+        return tasktracker::parse_number(field).value_or(0);
+    };
+
+    std::vector<WeatherRow> rows;
+    rows.reserve(table.rows());
+    double total_rain = 0;
+
+    // index,time,date,temperature,rain,clouds,wind, where rain is
+    // cumulative. The last row of the output isn't shown.
+    for (size_t i = 0; i + 1 < table.rows(); ++i) {
+        const auto fields = table.row(i);
+        if (fields.size() < 7) {
+            continue;
+        }
+        const double rain = number(fields[4]);
+
+        rows.push_back({ text(fields[1]),
+                         text(fields[2]),
+                         number(fields[3]),
+                         rain - total_rain,
+                         number(fields[5]),
+                         number(fields[6]),
+                         text(fields[3]),
+                         QString::number(rain - total_rain, 'g', 2),
+                         text(fields[5]),
+                         text(fields[6]) });
+        total_rain = rain;
+    }
+    return rows;
+}
 
+void
+WeatherListModel::setRows(std::vector<WeatherRow> rows)
+{
+    beginResetModel();
+    m_rows.swap(rows);
     endResetModel();
 }
 
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTest>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include "include/AddTaskServer.h"
+
+static std::atomic<size_t> allocations{ 0 };
+
+#if defined(__GLIBC__)
+// Qt allocates its containers with malloc, not operator new, so malloc is
+// what's counted. operator new calls it too.
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+
+    void* malloc(size_t size)
+    {
+        ++allocations;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        ++allocations;
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        ++allocations;
+        return __libc_realloc(ptr, size);
+    }
+}
+#endif
+
+/// @brief Serializing a task listing the way the API did before, through
+/// QVariantMap, QVariantList and QJsonArray, against JsonWriter. The
+/// allocations are only counted with glibc.
+class BenchJsonSerialization : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void sameOutput();
+    void serialize_data();
+    void serialize();
+
+  private:
+    std::vector<tasktracker::TaskData> m_tasks;
+
+    QByteArray withJsonArray() const;
+    QByteArray withJsonWriter() const;
+};
+
+void
+BenchJsonSerialization::initTestCase()
+{
+    m_tasks.resize(10000);
+    for (size_t i = 0; i < m_tasks.size(); ++i) {
+        m_tasks[i].id = i + 1;
+        m_tasks[i].name = "task \"" + std::to_string(i) + "\"";
+        m_tasks[i].scheduled_start = 1672650000 + i * 60;
+        m_tasks[i].repeat_type = tasktracker::RepeatType::WithInterval;
+        m_tasks[i].repeat_info = i % 7;
+    }
+}
+
+QByteArray
+BenchJsonSerialization::withJsonArray() const
+{
+    QVariantList list;
+    for (const auto& task : m_tasks) {
+        QVariantMap map = {
+            { "taskName", QString::fromStdString(task.name) },
+            { "taskID", task.id },
+            { "taskStart", static_cast<qint64>(task.scheduled_start) },
+            { "taskRepeatType", static_cast<int>(task.repeat_type) },
+            { "taskRepeatInfo", task.repeat_info },
+        };
+        list.append(map);
+    }
+    return QJsonDocument(QJsonArray::fromVariantList(list))
+      .toJson(QJsonDocument::Compact);
+}
+
+QByteArray
+BenchJsonSerialization::withJsonWriter() const
+{
+    QByteArray body;
+    body.reserve(m_tasks.size() * TASK_JSON_SIZE_HINT);
+    tasktracker::JsonWriter writer(body);
+
+    writer.begin_array();
+    for (const auto& task : m_tasks) {
+        writer.begin_object()
+          .member("taskName", task.name)
+          .member("taskID", task.id)
+          .member("taskStart", task.scheduled_start)
+          .member("taskRepeatType", static_cast<int>(task.repeat_type))
+          .member("taskRepeatInfo", task.repeat_info)
+          .end_object();
+    }
+    writer.end_array();
+    return body;
+}
+
+void
+BenchJsonSerialization::sameOutput()
+{
+    QCOMPARE(QJsonDocument::fromJson(withJsonWriter()),
+             QJsonDocument::fromJson(withJsonArray()));
+}
+
+void
+BenchJsonSerialization::serialize_data()
+{
+    QTest::addColumn<bool>("writer");
+
+    QTest::newRow("QVariantList to QJsonArray") << false;
+    QTest::newRow("JsonWriter<QByteArray>") << true;
+}
+
+void
+BenchJsonSerialization::serialize()
+{
+    QFETCH(bool, writer);
+    const auto run = [this, writer]() {
+        return writer ? withJsonWriter() : withJsonArray();
+    };
+
+    const size_t before = allocations;
+    const QByteArray body = run();
+    const size_t allocated = allocations - before;
+    qInfo().noquote() << QTest::currentDataTag() << "made" << allocated
+                      << "allocations for" << m_tasks.size() << "tasks,"
+                      << body.size() << "bytes";
+
+    QBENCHMARK {
+        const QByteArray result = run();
+        Q_UNUSED(result)
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchJsonSerialization)
+#include "bench_json_serialization.moc"
@@ -0,0 +1,84 @@
+#include <QTest>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+
+#include "include/TaskListModel.h"
+
+#define BENCHDBFILE "bench_tasklistmodel.db"
+
+/// @brief Throughput of TaskListModel::data, which views call for every
+/// role of every visible row whenever they repaint.
+class BenchTaskListModel : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void init();
+    void cleanup();
+    void dataThroughput_data();
+    void dataThroughput();
+
+  private:
+    std::unique_ptr<tasktracker::TaskTracker> m_tracker;
+};
+
+void
+BenchTaskListModel::init()
+{
+    m_tracker = std::make_unique<tasktracker::TaskTracker>(BENCHDBFILE);
+    m_tracker->clear();
+}
+
+void
+BenchTaskListModel::cleanup()
+{
+    m_tracker->clear();
+    m_tracker.reset();
+    std::filesystem::remove(BENCHDBFILE);
+}
+
+void
+BenchTaskListModel::dataThroughput_data()
+{
+    QTest::addColumn<int>("tasks");
+
+    QTest::newRow("10 tasks") << 10;
+    QTest::newRow("100 tasks") << 100;
+    QTest::newRow("1000 tasks") << 1000;
+}
+
+void
+BenchTaskListModel::dataThroughput()
+{
+    QFETCH(int, tasks);
+
+    // Daily tasks that started yesterday, so all of them are shown today.
+    const time_t start = time(nullptr) - 24 * 60 * 60;
+    m_tracker->transaction([this, tasks, start]() {
+        for (int i = 0; i < tasks; ++i) {
+            m_tracker->add_task("bench task " + std::to_string(i),
+                                tasktracker::RepeatType::WithInterval,
+                                1,
+                                start + i * 60);
+        }
+    });
+
+    TaskListModel model(m_tracker.get());
+    model.stopPrefetch();
+    QCOMPARE(model.rowCount(), tasks);
+    const QList<int> roles = model.roleNames().keys();
+
+    QBENCHMARK {
+        for (int row = 0; row < model.rowCount(); ++row) {
+            const QModelIndex index = model.index(row);
+            for (const int role : roles) {
+                const QVariant value = model.data(index, role);
+                Q_UNUSED(value)
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchTaskListModel)
+#include "bench_tasklistmodel.moc"
@@ -20,12 +20,24 @@
 #ifndef ADDTASKSERVER_H
 #define ADDTASKSERVER_H
 
+#include <array>
+#include <list>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 #include <QHttpServer>
+#include <QHttpServerResponder>
 #include <QHttpServerResponse>
+#include <QJsonArray>
+#include <QElapsedTimer>
 #include <QJsonObject>
+#include <QTimer>
+#include <QUrlQuery>
 
+#include <compression.h>
+#include <json_writer.h>
+#include <metrics.h>
 #include <tasktracklib.h>
 
 #ifndef TASKSERVER_PORT
@@ -33,6 +45,27 @@
 #endif
 
 #define TASK_UPDATE_PATH "/task"
+#define TASK_BATCH_PATH "/tasks/batch"
+#define UPCOMING_PATH "/upcoming"
+#define INSTANCES_PATH "/instances"
+#define EVENTS_PATH "/events"
+#define METRICS_PATH "/metrics"
+/// @brief how often the change log is checked for events to push
+#define EVENTS_INTERVAL_MS 250
+/// @brief how often idle event streams get a comment to keep them open
+#define EVENTS_KEEPALIVE_MS 15000
+/// @brief open event streams; the oldest is dropped when more connect
+#define EVENTS_MAX_CLIENTS 16
+/// @brief unsent bytes an event stream may have queued before the client
+/// is considered too slow and disconnected
+#define EVENTS_MAX_PENDING_BYTES (256 * 1024)
+#define UPCOMING_DEFAULT_COUNT 20
+/// @brief largest n accepted by GET /upcoming
+#define UPCOMING_MAX_COUNT 1000
+/// @brief approximate size of a serialized task, used to reserve buffers
+#define TASK_JSON_SIZE_HINT 96
+#define COMPRESSION_DEFAULT_LEVEL 6
+#define COMPRESSION_DEFAULT_THRESHOLD 1024
 
 struct TaskJSONRequest
 {
@@ -43,6 +76,34 @@ struct TaskJSONRequest
     int repeat_type;
 };
 
+/// @brief Task fields that can be selected with fields= on GET /task.
+enum class TaskField
+{
+    Name,
+    ID,
+    Start,
+    RepeatType,
+    RepeatInfo
+};
+
+/// @brief JSON keys of TaskField, in the same order.
+constexpr std::string_view taskFieldNames[] = {
+    "taskName", "taskID", "taskStart", "taskRepeatType", "taskRepeatInfo"
+};
+
+/// @brief Request count and duration metrics of a route, looked up once
+/// when the route is registered.
+struct RouteMetrics
+{
+    RouteMetrics(const char* path, const char* method);
+    /// @brief count a request and time it until the returned timer is
+    /// destroyed
+    tasktracker::ScopedMetricTimer observe() const;
+
+    tasktracker::MetricCounter* requests;
+    tasktracker::MetricHistogram* duration;
+};
+
 enum TaskUpdateOperation
 {
     Create,
@@ -50,6 +111,9 @@ enum TaskUpdateOperation
     Delete
 };
 
+/// @brief HTTP API for the tasks. The server may be moved to a worker
+/// thread; it locks the tracker for every request and dataModified is
+/// emitted from the thread the server lives in.
 class TaskServer : public QObject
 {
     Q_OBJECT
@@ -59,21 +123,79 @@ class TaskServer : public QObject
                         QObject* parent = nullptr);
     ~TaskServer();
     void start(quint16 port);
+    /// @brief set how responses are compressed for clients accepting gzip
+    /// or deflate.
+    /// @param level zlib compression level, 0-9
+    /// @param threshold responses smaller than this many bytes are sent
+    /// uncompressed
+    void setCompression(int level, qsizetype threshold);
 
   signals:
     void dataModified();
 
   private:
+    /// @brief An open GET /events stream.
+    struct EventClient
+    {
+        QHttpServerResponder responder;
+        /// @brief sequence of the last change record sent
+        uint64_t sequence;
+        /// @brief the last event the client got is from another run, so it
+        /// gets a reset before any records
+        bool reset;
+        /// @brief removes the client when its connection closes
+        QMetaObject::Connection disconnected;
+    };
+
     tasktracker::TaskTracker* m_tracker;
-    std::unique_ptr<QHttpServer> m_server;
+    QHttpServer* m_server;
+    /// @brief makes ETags and event IDs of different runs differ, as the
+    /// tracker generation and change sequence start over on every start
+    const QByteArray m_run_prefix;
+    /// @brief tracker generation m_tasks_body was serialized at
+    uint64_t m_tasks_generation;
+    /// @brief serialized body of the last full task listing
+    QByteArray m_tasks_body;
+    /// @brief m_tasks_body compressed, indexed by ContentEncoding. Empty
+    /// until a client asks for the encoding.
+    std::array<QByteArray, 3> m_tasks_compressed;
+    int m_compression_level;
+    qsizetype m_compression_threshold;
+    std::list<EventClient> m_event_clients;
+    QTimer* m_events_timer;
+    QElapsedTimer m_events_keepalive;
     QHttpServerResponse parseRequest(const QJsonObject& obj,
                                      TaskUpdateOperation op);
+    QHttpServerResponse parseBatchRequest(const QJsonArray& array);
+    QJsonObject applyRequest(const TaskJSONRequest& request,
+                             TaskUpdateOperation op);
     std::pair<bool, TaskJSONRequest> checkJsonFields(const QJsonObject& obj,
                                                      TaskUpdateOperation op);
-    void addTask(const TaskJSONRequest& request);
-    void modifyTask(const TaskJSONRequest& request);
+    int addTask(const TaskJSONRequest& request);
+    bool modifyTask(const TaskJSONRequest& request);
     void deleteTask(const TaskJSONRequest& request);
-    QHttpServerResponse getTasks();
+    QHttpServerResponse jsonResponse(
+      const QHttpServerRequest& request,
+      const QByteArray& body,
+      const QByteArray& etag = QByteArray(),
+      std::array<QByteArray, 3>* cache = nullptr);
+    QHttpServerResponse getTasks(const QHttpServerRequest& request);
+    void writeTask(tasktracker::JsonWriter<QByteArray>& writer,
+                   const tasktracker::Task* task,
+                   const std::vector<TaskField>& fields);
+    QHttpServerResponse getUpcoming(const QHttpServerRequest& request);
+    void getInstances(const QUrlQuery& query, QHttpServerResponder&& responder);
+    void getEvents(const QHttpServerRequest& request,
+                   QHttpServerResponder&& responder);
+    void pushEvents();
+    /// @brief write the change records the client hasn't got yet
+    /// @return false if the client is too slow and must be dropped
+    bool writeEvents(EventClient& client);
+    /// @brief close the connection of an event stream and forget it
+    /// @return iterator to the next client
+    std::list<EventClient>::iterator dropEventClient(
+      std::list<EventClient>::iterator client);
+    QHttpServerResponse getMetrics();
 };
 
 #endif /* ADDTASKSERVER_H */
@@ -22,18 +22,30 @@
 #include <QAbstractListModel>
 #include <QDate>
 #include <QTimer>
+#include <atomic>
 #include <scheduler.h>
 
+/// @brief time device events are collected for before notifying
+#define NOTIFY_COALESCE_MS 100
+
+/// @brief Delivers events from scheduler threads to the thread the object
+/// lives in. Events arriving within NOTIFY_COALESCE_MS of each other are
+/// merged into one notify.
 class QuickNotify : public QObject
 {
     Q_OBJECT
   public:
-    explicit QuickNotify(QObject* parent = nullptr)
-      : QObject(parent){};
-    void notify_slot() { emit notify(); };
+    explicit QuickNotify(QObject* parent = nullptr);
+    /// @brief request a notify. Can be called from any thread.
+    void notify_slot();
 
   signals:
     void notify();
+
+  private:
+    QTimer* m_timer;
+    /// @brief a notify has been requested but not emitted yet
+    std::atomic<bool> m_pending{ false };
 };
 
 enum DeviceListRole
@@ -54,6 +66,8 @@ class DeviceListModel : public QAbstractListModel
 
     QVariant data(const QModelIndex& index, int role) const override;
 
+    /// @brief reload the devices. The list is diffed against the current
+    /// one, so only added and removed devices are signalled.
     void populate();
 
     QHash<int, QByteArray> roleNames() const override;
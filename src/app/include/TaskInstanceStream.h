@@ -0,0 +1,76 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ *
+ * Author: Mike Salmela
+ */
+
+#ifndef TASKINSTANCESTREAM_H
+#define TASKINSTANCESTREAM_H
+
+#include <memory>
+#include <optional>
+
+#include <QByteArray>
+#include <QIODevice>
+
+#include <json_writer.h>
+#include <tasktracklib.h>
+
+#ifndef TASK_INSTANCE_STREAM_PAGE
+#define TASK_INSTANCE_STREAM_PAGE 256
+#endif
+
+/// @brief approximate size of a serialized task instance
+#define TASK_INSTANCE_JSON_SIZE_HINT 192
+
+/// @brief Read-only sequential device producing a JSON array of the task
+/// instances in a time range. Instances are read from the tracker one page at
+/// a time while the device is read, so memory use doesn't depend on the size
+/// of the range.
+class TaskInstanceStream : public QIODevice
+{
+    Q_OBJECT
+
+  public:
+    explicit TaskInstanceStream(tasktracker::TaskTracker* tracker,
+                                time_t from,
+                                time_t to,
+                                std::optional<tasktracker::TaskState> state,
+                                QObject* parent = nullptr);
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    bool atEnd() const override;
+
+  protected:
+    qint64 readData(char* data, qint64 maxlen) override;
+    qint64 writeData(const char* data, qint64 len) override;
+
+  private:
+    tasktracker::TaskTracker* m_tracker;
+    const time_t m_from;
+    const time_t m_to;
+    const std::optional<tasktracker::TaskState> m_state;
+
+    std::unique_ptr<tasktracker::TaskInstanceData> m_last;
+    QByteArray m_buffer;
+    qsizetype m_offset{ 0 };
+    bool m_finished{ false };
+
+    void fillBuffer();
+};
+
+#endif /* TASKINSTANCESTREAM_H */
@@ -22,8 +22,17 @@
 
 #include <QAbstractListModel>
 #include <QDate>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
 #include <tasktracklib.h>
 
+/// @brief time change notifications are collected for before refreshing
+#define REFRESH_COALESCE_MS 100
+/// @brief days before and after the displayed one that are loaded in the
+/// background, so navigating to them doesn't wait for the database
+#define PREFETCH_DAYS 3
+
 enum TaskListRole
 {
     TaskNameRole = Qt::UserRole + 1,
@@ -45,10 +54,17 @@ class TaskListModel : public QAbstractListModel
 
     QVariant data(const QModelIndex& index, int role) const override;
 
+    /// @brief reload the displayed day. Rows are diffed against the
+    /// current ones, so only inserted, removed, moved and changed rows are
+    /// signalled and views keep their delegates.
     void populate();
 
     QHash<int, QByteArray> roleNames() const override;
 
+    /// @brief cancel loading adjacent days and wait for the worker to stop.
+    /// Must be called before the tracker is destroyed.
+    void stopPrefetch();
+
   public slots:
     ///@brief set task finished.
     void setFinished(int index);
@@ -58,7 +74,11 @@ class TaskListModel : public QAbstractListModel
     void setSkipped(int index);
     ///@brief remove task. Removes all task instances of this task.
     void removeTask(int index);
+    ///@brief reload the displayed day.
     void refresh();
+    ///@brief refresh after REFRESH_COALESCE_MS. Notifications arriving
+    /// meanwhile are merged into the same refresh.
+    void scheduleRefresh();
     ///@brief set displayed day to next one.
     void nextDay();
     ///@brief set displayed day to previous one.
@@ -77,10 +97,45 @@ class TaskListModel : public QAbstractListModel
   private:
     tasktracker::TaskTracker* m_tracker;
 
-    QList<tasktracker::TaskInstance*> m_active_task_instance_list;
+    /// @brief A row and the values shown for it. They are read from the
+    /// instance when the row is loaded or changed, so data() only returns
+    /// them.
+    struct TaskRow
+    {
+        tasktracker::TaskInstance* instance;
+        /// @brief uid of the instance, used to diff the rows against a
+        /// reloaded list without touching the old instances.
+        std::string key;
+        QString name;
+        /// @brief scheduled start as hh:mm
+        QString start_time;
+        bool finished;
+        bool skipped;
+        bool started;
+    };
+
+    QList<TaskRow> m_rows;
+    /// @brief tracker generation m_rows was read at. The API thread may
+    /// delete the instances before the queued refresh arrives, so the
+    /// instances are only used while this matches.
+    uint64_t m_generation{ 0 };
 
     time_t m_date;
+    QTimer* m_refresh_timer;
+    /// @brief runs prefetch jobs one at a time
+    QThreadPool m_prefetch_pool;
+    /// @brief incremented by every prefetch, so an outdated job stops early
+    std::atomic<uint64_t> m_prefetch_token{ 0 };
     QDate currentDate();
+    /// @brief load the PREFETCH_DAYS days around the displayed one into the
+    /// tracker's instance cache on a worker thread.
+    void prefetch();
+    static TaskRow makeRow(tasktracker::TaskInstance* instance);
+    /// @brief get the roles whose values differ between two rows.
+    static QList<int> changedRoles(const TaskRow& a, const TaskRow& b);
+    /// @brief apply a state change to the instance on a row and signal the
+    /// roles it changed.
+    void changeState(int index, void (tasktracker::TaskInstance::*change)());
 };
 
 #endif /* TASKLIST_H */
@@ -21,8 +21,14 @@
 
 #include <QAbstractListModel>
 #include <QDate>
+#include <QProcess>
 #include <QTimer>
+#include <csv_table.h>
 #include <scheduler.h>
+#include <optional>
+
+/// @brief the weather program is killed if it runs longer than this
+#define WEATHER_FETCH_TIMEOUT_MS 30000
 
 enum WeatherListRole
 {
@@ -39,27 +45,68 @@ class WeatherListModel : public QAbstractListModel
     Q_OBJECT
 
   public:
+    /// @param cache_path the last forecast fetched is saved here and shown
+    /// on startup; empty to not cache it
     explicit WeatherListModel(std::filesystem::path weather_csv_program,
                               std::string location = "nokia",
                               int utc_diff = 3,
+                              std::filesystem::path cache_path = {},
                               QObject* parent = nullptr);
 
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
 
     QVariant data(const QModelIndex& index, int role) const override;
 
+    /// @brief show the cached forecast and start refreshing it every
+    /// m_refresh_time_s. If the cache is missing or older than that, a
+    /// fetch is started right away.
     void populate();
 
     QHash<int, QByteArray> roleNames() const override;
 
   private:
     QTimer* m_timer;
+    QProcess* m_process;
+    QTimer* m_fetch_timeout;
     std::filesystem::path m_weather_program;
+    std::filesystem::path m_cache_path;
     std::string m_location;
     int m_utc_diff;
     int m_refresh_time_s{ 3600 };
-    std::string m_api_output;
-    std::vector<std::vector<std::string>> m_api_output_lines;
+
+    /// @brief A forecast hour, converted once when the output is parsed so
+    /// data() only returns the fields.
+    struct WeatherRow
+    {
+        QString time;
+        QString date;
+        double temperature;
+        /// @brief rain since the previous row
+        double rain;
+        double clouds;
+        double wind;
+        QString temperature_text;
+        QString rain_text;
+        QString clouds_text;
+        QString wind_text;
+    };
+
+    std::vector<WeatherRow> m_rows;
+    /// @brief start fetching the weather and return. The rows are replaced
+    /// once the program has finished and its output is parsed; if it fails
+    /// the old rows are kept.
+    void fetch();
+    void fetchFinished(int exit_code, QProcess::ExitStatus status);
+    /// @brief show the rows saved in the cache file.
+    /// @return when the cached forecast was fetched, in seconds since the
+    /// epoch, or std::nullopt if there is no cache or it was fetched for
+    /// another location or timezone
+    std::optional<qint64> loadCache();
+    /// @brief the timezone and location a fetch is made for, as saved in
+    /// the cache header
+    QByteArray cacheKey() const;
+    static std::vector<WeatherRow> makeRows(const tasktracker::CsvTable& table);
+    void setRows(std::vector<WeatherRow> rows);
 };
 
 #endif /* DEVICELISTMODEL_H */
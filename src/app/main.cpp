@@ -23,10 +23,13 @@
 #include <time.h>
 
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QGuiApplication>
 #include <QNetworkInterface>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QThread>
 #include <QTimer>
 #include <simpleini.h>
 
@@ -76,6 +79,39 @@ get_api_port(const simpleini::SimpleINI& config)
     return port;
 }
 
+int
+get_compression_level(const simpleini::SimpleINI& config)
+{
+    int level = 0;
+
+    try {
+        level = config["tasktrackerapi"].get_as<int>("compression_level");
+    } catch (...) {
+        qDebug() << "Value for compression_level not found in config. Using "
+                    "default value"
+                 << COMPRESSION_DEFAULT_LEVEL;
+        level = COMPRESSION_DEFAULT_LEVEL;
+    }
+    return level;
+}
+
+unsigned
+get_compression_threshold(const simpleini::SimpleINI& config)
+{
+    unsigned threshold = 0;
+
+    try {
+        threshold =
+          config["tasktrackerapi"].get_as<unsigned>("compression_threshold");
+    } catch (...) {
+        qDebug() << "Value for compression_threshold not found in config. "
+                    "Using default value"
+                 << COMPRESSION_DEFAULT_THRESHOLD;
+        threshold = COMPRESSION_DEFAULT_THRESHOLD;
+    }
+    return threshold;
+}
+
 unsigned
 get_webui_port(const simpleini::SimpleINI& config)
 {
@@ -91,6 +127,36 @@ get_webui_port(const simpleini::SimpleINI& config)
     return port;
 }
 
+unsigned
+get_sync_interval(const simpleini::SimpleINI& config)
+{
+    unsigned interval = 0;
+
+    try {
+        interval = config["tasktracker"].get_as<unsigned>("sync_interval");
+    } catch (...) {
+        qDebug() << "Value for sync_interval not found in config. Using "
+                    "default value 5";
+        interval = 5;
+    }
+    return interval;
+}
+
+int
+get_catch_up_horizon(const simpleini::SimpleINI& config)
+{
+    int horizon = 0;
+
+    try {
+        horizon = config["tasktracker"].get_as<int>("catch_up_days");
+    } catch (...) {
+        qDebug() << "Value for catch_up_days not found in config. Using "
+                    "default value 31";
+        horizon = 31;
+    }
+    return horizon;
+}
+
 simpleini::SimpleINI
 get_config(const std::string& conf_path)
 {
@@ -115,6 +181,109 @@ create_test_tasks_set(int argc, char* argv[])
     return false;
 }
 
+bool
+is_headless(int argc, char* argv[], const simpleini::SimpleINI& config)
+{
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "headless") == 0) {
+            return true;
+        }
+    }
+    try {
+        return config["tasktracker"].get_as<int>("headless") != 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+std::filesystem::path
+get_db_path()
+{
+    QDir().mkdir(QDir().homePath() + "/.tasktracker/");
+    return QDir().homePath().toStdString() + "/.tasktracker/" + "tasks.db";
+}
+
+void
+prepare_tracker(tasktracker::TaskTracker& tracker,
+                int argc,
+                char* argv[],
+                const simpleini::SimpleINI& config)
+{
+    if (create_test_tasks_set(argc, argv)) {
+        add_test_tasks(&tracker);
+    }
+    tracker.catch_up(get_catch_up_horizon(config));
+}
+
+/// @brief pick up changes written to the database by other programs.
+/// @return true if the tracker changed
+bool
+sync_tracker(tasktracker::TaskTracker& tracker)
+{
+    try {
+        return tracker.sync();
+    } catch (tasktracker::DatabaseErr& err) {
+        // E.g. SQLITE_BUSY while the other program writes; the next tick
+        // tries again.
+        qWarning() << "Syncing the database failed:" << err.what();
+    }
+    return false;
+}
+
+/// @brief log how long starting took and the resident memory, read from
+/// /proc/self/status.
+void
+report_startup(const QElapsedTimer& startup)
+{
+    QByteArray rss = "unknown";
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        while (!status.atEnd()) {
+            const QByteArray line = status.readLine();
+            if (line.startsWith("VmRSS:")) {
+                rss = line.mid(6).simplified();
+                break;
+            }
+        }
+    }
+    qInfo() << "Started in" << startup.elapsed() << "ms, resident memory"
+            << rss.constData();
+}
+
+/// @brief Serve only the HTTP API, without the Qt Quick stack, the device
+/// scheduler or the weather. Needs no display.
+int
+run_headless(int argc,
+             char* argv[],
+             const simpleini::SimpleINI& config,
+             const QElapsedTimer& startup)
+{
+    QCoreApplication app(argc, argv);
+    tasktracker::TaskTracker tracker(get_db_path());
+    prepare_tracker(tracker, argc, argv, config);
+
+    // Nothing else runs on the event loop, so the server stays on the
+    // main thread.
+    TaskServer server(&tracker);
+    server.setCompression(get_compression_level(config),
+                          get_compression_threshold(config));
+    server.start(get_api_port(config));
+
+    // Pick up changes written to the database by other programs.
+    QTimer syncTimer;
+    syncTimer.setInterval(get_sync_interval(config) * 1000);
+    QObject::connect(&syncTimer, &QTimer::timeout, [&tracker]() {
+        sync_tracker(tracker);
+    });
+    syncTimer.start();
+
+    report_startup(startup);
+    const int ret = app.exec();
+
+    tracker.save_snapshot();
+    return ret;
+}
+
 std::unique_ptr<BoredomScheduler>
 make_boredom_scheduler(const simpleini::SimpleINI& config)
 {
@@ -128,6 +297,8 @@ make_boredom_scheduler(const simpleini::SimpleINI& config)
     return scheduler;
 }
 
+/// @brief device event callback of the scheduler. Runs on the scheduler's
+/// thread; QuickNotify passes the event on to the GUI thread.
 void
 refresh_device_list(void* data)
 {
@@ -140,6 +311,7 @@ make_weather_list(QObject* parent, const simpleini::SimpleINI& config)
 {
     std::string program;
     std::string city;
+    std::string cache;
     int tmzone;
 
     try {
@@ -162,35 +334,54 @@ make_weather_list(QObject* parent, const simpleini::SimpleINI& config)
         qWarning() << "Weather timezone not set.";
         tmzone = 3;
     }
+
+    try {
+        cache = config["Weather"]["cache"];
+    } catch (...) {
+        cache = QDir().homePath().toStdString() + "/.tasktracker/weather.csv";
+    }
     qDebug() << "Weather settings:";
     qDebug() << "Program:" << program;
     qDebug() << "City:" << city;
     qDebug() << "tmzone:" << tmzone;
+    qDebug() << "Cache:" << cache;
 
     WeatherListModel* weatherListModel =
-      new WeatherListModel(program, city, tmzone, parent);
+      new WeatherListModel(program, city, tmzone, cache, parent);
     return weatherListModel;
 }
 
 int
 main(int argc, char* argv[])
 {
-    QGuiApplication app(argc, argv);
+    QElapsedTimer startup;
+    startup.start();
+    auto config = get_config(confpath);
+    if (is_headless(argc, argv, config)) {
+        return run_headless(argc, argv, config, startup);
+    }
 
-    std::filesystem::path db_path =
-      QDir().homePath().toStdString() + "/.tasktracker/" + "tasks.db";
-    QDir().mkdir(QDir().homePath() + "/.tasktracker/");
-    tasktracker::TaskTracker tracker(db_path);
-    TaskServer* server = new TaskServer(&tracker, &app);
+    QGuiApplication app(argc, argv);
+    tasktracker::TaskTracker tracker(get_db_path());
     QuickNotify* notifyer = new QuickNotify(&app);
 
-    auto config = get_config(confpath);
     auto scheduler = make_boredom_scheduler(config);
 
-    server->start(get_api_port(config));
-    if (create_test_tasks_set(argc, argv)) {
-        add_test_tasks(&tracker);
-    }
+    // The API runs on its own thread so slow requests don't stall the UI.
+    // The tracker is shared, so everyone locks it while using it.
+    QThread* serverThread = new QThread(&app);
+    TaskServer* server = new TaskServer(&tracker);
+    server->setCompression(get_compression_level(config),
+                           get_compression_threshold(config));
+    server->moveToThread(serverThread);
+    QObject::connect(
+      serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread->start();
+    const quint16 port = get_api_port(config);
+    QMetaObject::invokeMethod(
+      server, [server, port]() { server->start(port); });
+
+    prepare_tracker(tracker, argc, argv, config);
 
     TaskListModel* taskListModel = new TaskListModel(&tracker, &app);
     qmlRegisterSingletonInstance(
@@ -221,7 +412,19 @@ main(int argc, char* argv[])
     QObject::connect(server,
                      &TaskServer::dataModified,
                      taskListModel,
-                     &TaskListModel::refresh);
+                     &TaskListModel::scheduleRefresh,
+                     Qt::QueuedConnection);
+
+    // Pick up changes written to the database by other programs.
+    QTimer* syncTimer = new QTimer(&app);
+    syncTimer->setInterval(get_sync_interval(config) * 1000);
+    QObject::connect(
+      syncTimer, &QTimer::timeout, taskListModel, [&tracker, taskListModel]() {
+          if (sync_tracker(tracker)) {
+              taskListModel->scheduleRefresh();
+          }
+      });
+    syncTimer->start();
 
     scheduler->set_device_event_cb(refresh_device_list);
     scheduler->set_event_cb_data(notifyer);
@@ -246,5 +449,12 @@ main(int argc, char* argv[])
       },
       Qt::QueuedConnection);
     engine.load(url);
-    return app.exec();
+    report_startup(startup);
+    const int ret = app.exec();
+
+    taskListModel->stopPrefetch();
+    serverThread->quit();
+    serverThread->wait();
+    tracker.save_snapshot();
+    return ret;
 }
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <csv_table.h>
+#include <database_driver.h>
+#include <filesystem>
+#include <iostream>
+#include <json_writer.h>
+#include <sqlite3.h>
+#include <task.h>
+#include <tasktracklib.h>
+#include <thread>
+
+#define BENCHDBFILE "bench.db"
+
+using namespace tasktracker;
+
+/// @brief Silences the progress the library prints to std::cout while in
+/// scope, so it doesn't drown the results.
+class QuietCout
+{
+  public:
+    QuietCout()
+      : m_buf(std::cout.rdbuf(nullptr))
+    {
+    }
+    ~QuietCout() { std::cout.rdbuf(m_buf); }
+
+  private:
+    std::streambuf* m_buf;
+};
+
+static tm
+start_day()
+{
+    tm day{};
+    day.tm_year = 2024 - 1900;
+    day.tm_mday = 1;
+    day.tm_hour = 9;
+    day.tm_isdst = -1;
+    return day;
+}
+
+static tm
+add_days(tm day, int days)
+{
+    day.tm_mday += days;
+    mktime(&day);
+    return day;
+}
+
+/// @brief repeat_info giving a task of the type a few occurrences a month
+static int
+repeat_info_for(RepeatType type, int64_t i)
+{
+    switch (type) {
+        case RepeatType::Monthly:
+            return 1 + i % 28;
+        case RepeatType::MonthlyDay:
+            return 11 + i % 4 * 10 + i % 7;
+        case RepeatType::SpecifiedDays:
+            return 135;
+        case RepeatType::WithInterval:
+            return 1 + i % 7;
+        case RepeatType::NoRepeat:
+            break;
+    }
+    return 0;
+}
+
+/// @brief clear the tracker and add tasks of all repeat types.
+static void
+fill_tracker(TaskTracker& tracker, int64_t tasks)
+{
+    tracker.clear();
+    tracker.transaction([&tracker, tasks]() {
+        for (int64_t i = 0; i < tasks; ++i) {
+            const auto type = static_cast<RepeatType>(i % 5);
+            tracker.add_task("bench task " + std::to_string(i),
+                             type,
+                             repeat_info_for(type, i),
+                             add_days(start_day(), i % 30));
+        }
+    });
+}
+
+static void
+BM_task_occurs(benchmark::State& state)
+{
+    const auto type = static_cast<RepeatType>(state.range(0));
+    const int64_t days = state.range(1);
+    TaskDatabase db(BENCHDBFILE);
+    TaskData data{};
+    data.name = "bench task";
+    tm start = start_day();
+    data.scheduled_start = mktime(&start);
+    data.repeat_type = type;
+    data.repeat_info = repeat_info_for(type, 3);
+    Task task(&data, &db);
+
+    std::vector<tm> dates;
+    for (int64_t i = 0; i < days; ++i) {
+        dates.push_back(add_days(start, i));
+    }
+
+    for (auto _ : state) {
+        int occurrences = 0;
+        for (const auto& date : dates) {
+            occurrences += task.occurs(date);
+        }
+        benchmark::DoNotOptimize(occurrences);
+    }
+    state.SetItemsProcessed(state.iterations() * days);
+}
+BENCHMARK(BM_task_occurs)->ArgsProduct({ { RepeatType::NoRepeat,
+                                           RepeatType::Monthly,
+                                           RepeatType::MonthlyDay,
+                                           RepeatType::SpecifiedDays,
+                                           RepeatType::WithInterval },
+                                         { 31, 365 } });
+
+static void
+BM_get_task_instances_cold(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+    int offset = 0;
+
+    // Every iteration asks for a day not loaded before, so the instances
+    // are created and stored.
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+          tracker.get_task_instances(add_days(start_day(), offset++)));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_get_task_instances_cold)->RangeMultiplier(8)->Range(8, 512);
+
+static void
+BM_get_task_instances_warm(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+    const tm day = add_days(start_day(), 10);
+    tracker.get_task_instances(day);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tracker.get_task_instances(day));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_get_task_instances_warm)->RangeMultiplier(8)->Range(8, 512);
+
+static void
+BM_add_delete_task(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+
+    for (auto _ : state) {
+        const int id = tracker.add_task(
+          "added task", RepeatType::WithInterval, 2, start_day());
+        tracker.delete_task(id);
+    }
+}
+BENCHMARK(BM_add_delete_task)->RangeMultiplier(8)->Range(8, 512);
+
+static void
+BM_modify_task(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+    TaskData data = *tracker.get_tasks().front()->get_data();
+
+    for (auto _ : state) {
+        data.repeat_info = data.repeat_info % 7 + 1;
+        tracker.modify_task(&data);
+    }
+}
+BENCHMARK(BM_modify_task)->RangeMultiplier(8)->Range(8, 512);
+
+static void
+BM_instance_state_transitions(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+    TaskInstance* instance =
+      tracker.get_task_instances(add_days(start_day(), 1)).front();
+
+    for (auto _ : state) {
+        instance->start_task();
+        instance->finish_task();
+        instance->set_undone();
+        instance->skip_task();
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_instance_state_transitions)->RangeMultiplier(8)->Range(8, 512);
+
+static void
+BM_read_wait_under_writes(benchmark::State& state)
+{
+    const QuietCout quiet;
+    TaskTracker tracker(BENCHDBFILE);
+    fill_tracker(tracker, state.range(0));
+    const tm day = add_days(start_day(), 10);
+    tracker.get_task_instances(day);
+
+    // Like the API thread: single writes and batches. The tasks only occur
+    // on the first day, so the read day stays loaded and the reader only
+    // waits for the tracker's locks, not for instances to be created.
+    std::atomic<bool> stop{ false };
+    std::thread writer([&tracker, &stop]() {
+        for (int i = 0; !stop; ++i) {
+            if (i % 4 == 3) {
+                tracker.transaction([&tracker]() {
+                    for (int j = 0; j < 16; ++j) {
+                        tracker.delete_task(tracker.add_task(
+                          "batch task", RepeatType::NoRepeat, 0, start_day()));
+                    }
+                });
+            } else {
+                tracker.delete_task(tracker.add_task(
+                  "added task", RepeatType::NoRepeat, 0, start_day()));
+            }
+        }
+    });
+
+    // Each iteration is a frame of the UI reading the day.
+    std::vector<std::chrono::steady_clock::duration> waits;
+    for (auto _ : state) {
+        const auto begin = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::recursive_mutex> database;
+            auto lock = tracker.lock();
+            if (!tracker.is_day_loaded(day)) {
+                lock.unlock();
+                database = tracker.database_lock();
+                lock.lock();
+            }
+            benchmark::DoNotOptimize(tracker.get_task_instances(day));
+        }
+        waits.push_back(std::chrono::steady_clock::now() - begin);
+    }
+    stop = true;
+    writer.join();
+
+    std::sort(waits.begin(), waits.end());
+    const auto micros = [](std::chrono::steady_clock::duration wait) {
+        return std::chrono::duration<double, std::micro>(wait).count();
+    };
+    state.counters["p99_wait_us"] = micros(waits[waits.size() * 99 / 100]);
+    state.counters["max_wait_us"] = micros(waits.back());
+}
+// Frame reads of a loaded day while another thread writes.
+BENCHMARK(BM_read_wait_under_writes)->Arg(64)->Arg(512)->UseRealTime();
+
+static void
+BM_task_database_load(benchmark::State& state)
+{
+    TaskDatabase db(BENCHDBFILE);
+    db.clear();
+    db.begin_transaction();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        db.create_task("bench task " + std::to_string(i));
+    }
+    db.commit();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get_tasks());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_task_database_load)->RangeMultiplier(8)->Range(8, 4096);
+
+static void
+BM_task_instance_database_load(benchmark::State& state)
+{
+    TaskInstanceDatabase db(BENCHDBFILE);
+    db.clear();
+    tm day = start_day();
+    std::vector<TaskInstanceData> instances(state.range(0));
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        auto& instance = instances[i];
+        instance.id = "bench-" + std::to_string(i);
+        instance.parent_id = 1 + i % 16;
+        instance.name = "bench task " + std::to_string(i % 16);
+        instance.scheduled_start = mktime(&day) + i * 60 * 60;
+        instance.state = TaskState::NotStarted;
+    }
+    db.create_tasks(instances);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get_tasks());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_task_instance_database_load)->RangeMultiplier(8)->Range(8, 4096);
+
+static void
+BM_tracker_startup(benchmark::State& state)
+{
+    const int64_t tasks = state.range(0);
+    const bool snapshot = state.range(1);
+    {
+        const QuietCout quiet;
+        TaskTracker tracker(BENCHDBFILE);
+        tracker.clear();
+    }
+    std::filesystem::remove(BENCHDBFILE ".snapshot");
+
+    sqlite3* db = nullptr;
+    sqlite3_open(BENCHDBFILE, &db);
+    const std::string insert =
+      "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+      "WHERE i < " +
+      std::to_string(tasks) +
+      ") INSERT INTO TASKS (TASKNAME, BEGINNING, COMMENT, REPEATTYPE, "
+      "REPEATINFO) SELECT 'task ' || i, 1672531200 + i, 'comment', 4, "
+      "i % 7 + 1 FROM n;";
+    sqlite3_exec(db, insert.c_str(), NULL, NULL, NULL);
+    sqlite3_close(db);
+
+    if (snapshot) {
+        TaskTracker(BENCHDBFILE).save_snapshot();
+    }
+
+    for (auto _ : state) {
+        TaskTracker tracker(BENCHDBFILE);
+        benchmark::DoNotOptimize(tracker.get_tasks().size());
+    }
+    state.SetItemsProcessed(state.iterations() * tasks);
+    std::filesystem::remove(BENCHDBFILE ".snapshot");
+}
+// Loading the tasks from the database or from a snapshot.
+BENCHMARK(BM_tracker_startup)
+  ->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })
+  ->Unit(benchmark::kMillisecond);
+
+static void
+BM_csv_table_parse(benchmark::State& state)
+{
+    std::string text = "index,time,date,temperature,rain,clouds,wind,\n";
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        text += std::to_string(i) + "," + std::to_string(i % 24) + ":00," +
+                std::to_string(1 + i / 24) + ".6.,12.5," +
+                std::to_string(i / 10) + ".0,80,3.2,\n";
+    }
+
+    for (auto _ : state) {
+        const CsvTable table(text);
+        double rain = 0;
+        for (size_t row = 0; row < table.rows(); ++row) {
+            rain += parse_number(table.row(row)[4]).value_or(0);
+        }
+        benchmark::DoNotOptimize(rain);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+// Up to four weeks of hourly forecast.
+BENCHMARK(BM_csv_table_parse)->Arg(48)->Arg(7 * 24)->Arg(28 * 24);
+
+static void
+BM_json_writer(benchmark::State& state)
+{
+    std::vector<TaskData> tasks(state.range(0));
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].id = i + 1;
+        tasks[i].name = "task \"" + std::to_string(i) + "\"";
+        tasks[i].scheduled_start = 1672650000 + i * 60;
+        tasks[i].repeat_type = RepeatType::WithInterval;
+        tasks[i].repeat_info = i % 7;
+    }
+
+    // The buffer is reused like the server reuses it between pages.
+    std::string buffer;
+    for (auto _ : state) {
+        buffer.clear();
+        JsonWriter writer(buffer);
+        writer.begin_array();
+        for (const auto& task : tasks) {
+            writer.begin_object()
+              .member("taskName", task.name)
+              .member("taskID", task.id)
+              .member("taskStart", task.scheduled_start)
+              .member("taskRepeatType", static_cast<int>(task.repeat_type))
+              .member("taskRepeatInfo", task.repeat_info)
+              .end_object();
+        }
+        writer.end_array();
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetItemsProcessed(state.iterations() * tasks.size());
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_json_writer)->RangeMultiplier(10)->Range(100, 10000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,81 @@
+#include <compression.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <zlib.h>
+
+#define NAME test_compression
+
+using namespace tasktracker;
+
+static std::string
+decompress(const std::string& data)
+{
+    z_stream stream{};
+    // +32 detects both the zlib and the gzip format.
+    inflateInit2(&stream, 15 + 32);
+
+    std::string result(1 << 20, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = result.size();
+
+    const int ret = inflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END ? result : std::string();
+}
+
+TEST(NAME, test_choose_content_encoding)
+{
+    ASSERT_EQ(choose_content_encoding(""), ContentEncoding::Identity);
+    ASSERT_EQ(choose_content_encoding("gzip"), ContentEncoding::Gzip);
+    ASSERT_EQ(choose_content_encoding("deflate, gzip;q=1.0"),
+              ContentEncoding::Gzip);
+    ASSERT_EQ(choose_content_encoding("br, deflate"), ContentEncoding::Deflate);
+    ASSERT_EQ(choose_content_encoding("GZip;q=0.5, identity"),
+              ContentEncoding::Gzip);
+    ASSERT_EQ(choose_content_encoding("gzip;q=0, deflate;q=0.2"),
+              ContentEncoding::Deflate);
+    ASSERT_EQ(choose_content_encoding("gzip; q=0.000, deflate;q=0"),
+              ContentEncoding::Identity);
+    ASSERT_EQ(choose_content_encoding("*"), ContentEncoding::Gzip);
+    ASSERT_EQ(choose_content_encoding("gzip;q=0, *"), ContentEncoding::Deflate)
+      << "* only applies to codings that aren't listed.";
+    ASSERT_EQ(choose_content_encoding("*, gzip;q=0, deflate;q=0"),
+              ContentEncoding::Identity);
+    ASSERT_EQ(choose_content_encoding("*;q=0, deflate"),
+              ContentEncoding::Deflate);
+    ASSERT_EQ(choose_content_encoding("br, identity"),
+              ContentEncoding::Identity);
+}
+
+TEST(NAME, test_compress)
+{
+    std::string data;
+    for (int i = 0; i < 10000; ++i) {
+        data += R"({"taskName":"task )" + std::to_string(i) +
+                R"(","taskID":)" + std::to_string(i) + "},";
+    }
+
+    const auto gzip = compress(data, ContentEncoding::Gzip, 6);
+    ASSERT_TRUE(gzip);
+    ASSERT_LT(gzip->size(), data.size() / 4);
+    ASSERT_EQ(static_cast<unsigned char>((*gzip)[0]), 0x1f) << "gzip magic";
+    ASSERT_EQ(decompress(*gzip), data);
+
+    const auto deflate = compress(data, ContentEncoding::Deflate, 1);
+    ASSERT_TRUE(deflate);
+    ASSERT_EQ(static_cast<unsigned char>((*deflate)[0]), 0x78) << "zlib header";
+    ASSERT_EQ(decompress(*deflate), data);
+
+    ASSERT_EQ(decompress(*compress("", ContentEncoding::Gzip, 9)), "");
+    ASSERT_FALSE(compress(data, ContentEncoding::Identity, 6));
+}
+
+int
+main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
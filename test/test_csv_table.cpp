@@ -0,0 +1,76 @@
+#include <csv_table.h>
+#include <gtest/gtest.h>
+#include <string>
+
+#define NAME test_csv_table
+
+using namespace tasktracker;
+
+TEST(NAME, test_split)
+{
+    const CsvTable table("index,time,date\n"
+                         "0,12:00,1.6.\r\n"
+                         "\n"
+                         "1,13:00,1.6.,\n"
+                         "2,,last");
+
+    ASSERT_EQ(table.rows(), 3);
+    ASSERT_EQ(table.row(0).size(), 3);
+    ASSERT_EQ(table.row(0)[1], "12:00");
+    ASSERT_EQ(table.row(0)[2], "1.6.");
+    ASSERT_EQ(table.row(1).size(), 4);
+    ASSERT_EQ(table.row(1)[3], "");
+    ASSERT_EQ(table.row(2)[1], "");
+    ASSERT_EQ(table.row(2)[2], "last");
+
+    ASSERT_EQ(CsvTable("a,b\n").rows(), 0);
+    ASSERT_EQ(CsvTable("a,b", false).rows(), 1);
+    ASSERT_EQ(CsvTable().rows(), 0);
+}
+
+TEST(NAME, test_moved_table_keeps_fields)
+{
+    CsvTable table("h\na,b\n");
+    const CsvTable moved(std::move(table));
+
+    ASSERT_EQ(moved.row(0)[0], "a");
+    ASSERT_EQ(moved.row(0)[1], "b");
+}
+
+TEST(NAME, test_parse_number)
+{
+    ASSERT_EQ(parse_number("12.5"), 12.5);
+    ASSERT_EQ(parse_number(" -3 "), -3);
+    ASSERT_EQ(parse_number("+0.25"), 0.25);
+    ASSERT_FALSE(parse_number(""));
+    ASSERT_FALSE(parse_number("12mm"));
+    ASSERT_FALSE(parse_number("n/a"));
+}
+
+TEST(NAME, test_forecast)
+{
+    // Three weeks of hourly rows as written by the weather program.
+    const int hours = 21 * 24;
+    std::string text = "index,time,date,temperature,rain,clouds,wind,\n";
+    for (int i = 0; i < hours; ++i) {
+        text += std::to_string(i) + "," + std::to_string(i % 24) + ":00," +
+                std::to_string(1 + i / 24) + ".6.," + std::to_string(i % 30) +
+                ".5," + std::to_string(i / 10) + ".0,80,3.2,\n";
+    }
+
+    const CsvTable table(text);
+    ASSERT_EQ(table.rows(), hours);
+    for (size_t i = 0; i < table.rows(); ++i) {
+        const auto row = table.row(i);
+        ASSERT_EQ(row.size(), 8);
+        ASSERT_EQ(parse_number(row[0]), i);
+        ASSERT_EQ(parse_number(row[4]), i / 10);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <json_writer.h>
+#include <new>
+#include <string>
+#include <task_data.h>
+#include <vector>
+
+#define NAME test_json_writer
+
+using namespace tasktracker;
+
+static std::atomic<size_t> allocations{ 0 };
+
+void*
+operator new(size_t size)
+{
+    ++allocations;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+static void
+write_task(JsonWriter<std::string>& writer, const TaskData& task)
+{
+    writer.begin_object()
+      .member("taskName", task.name)
+      .member("taskID", task.id)
+      .member("taskStart", task.scheduled_start)
+      .member("taskRepeatType", static_cast<int>(task.repeat_type))
+      .member("taskRepeatInfo", task.repeat_info)
+      .end_object();
+}
+
+TEST(NAME, test_structure)
+{
+    std::string buffer;
+    JsonWriter writer(buffer);
+
+    writer.begin_object()
+      .member("name", "task")
+      .member("id", 42)
+      .member("start", -1700000000LL)
+      .member("done", false)
+      .key("list")
+      .begin_array()
+      .value(1)
+      .begin_object()
+      .end_object()
+      .begin_array()
+      .end_array()
+      .value(true)
+      .end_array()
+      .end_object();
+
+    ASSERT_EQ(buffer,
+              R"({"name":"task","id":42,"start":-1700000000,"done":false,)"
+              R"("list":[1,{},[],true]})");
+}
+
+TEST(NAME, test_escaping)
+{
+    std::string buffer;
+    JsonWriter writer(buffer);
+
+    writer.value(std::string_view("a\"b\\c\nd\re\tf\x01g\x1fh\0i", 17));
+    ASSERT_EQ(buffer, R"("a\"b\\c\nd\re\tf\u0001g\u001fh\u0000i")");
+
+    buffer.clear();
+    JsonWriter(buffer).value("sauna \xc3\xa4\xc3\xb6 \xe2\x82\xac");
+    ASSERT_EQ(buffer, "\"sauna \xc3\xa4\xc3\xb6 \xe2\x82\xac\"")
+      << "UTF-8 must be passed through as is.";
+}
+
+TEST(NAME, test_serialize_tasks)
+{
+    std::vector<TaskData> tasks(10000);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].id = i + 1;
+        tasks[i].name = "task \"" + std::to_string(i) + "\"";
+        tasks[i].scheduled_start = 1672650000 + i * 60;
+        tasks[i].repeat_type = RepeatType::WithInterval;
+        tasks[i].repeat_info = i % 7;
+    }
+
+    std::string buffer;
+    const auto serialize = [&]() {
+        buffer.clear();
+        JsonWriter writer(buffer);
+        writer.begin_array();
+        for (const auto& task : tasks) {
+            write_task(writer, task);
+        }
+        writer.end_array();
+    };
+
+    // The first run grows the buffer, later runs reuse it.
+    serialize();
+    const size_t size = buffer.size();
+
+    const size_t before = allocations;
+    serialize();
+    const size_t allocated = allocations - before;
+
+    ASSERT_EQ(buffer.size(), size);
+    ASSERT_EQ(allocated, 0);
+    const std::string first =
+      R"([{"taskName":"task \"0\"","taskID":1,"taskStart":1672650000,)"
+      R"("taskRepeatType":4,"taskRepeatInfo":0},{)";
+    ASSERT_EQ(buffer.substr(0, first.size()), first);
+}
+
+int
+main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
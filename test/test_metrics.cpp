@@ -0,0 +1,124 @@
+#include <database_driver.h>
+#include <gtest/gtest.h>
+#include <metrics.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define NAME test_metrics
+#define TESTDBFILE "test_metrics.db"
+
+using namespace tasktracker;
+
+TEST(NAME, test_counter)
+{
+    MetricCounter counter;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&counter]() {
+            for (int j = 0; j < 10000; ++j) {
+                counter.add();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(counter.value(), 40000);
+}
+
+TEST(NAME, test_histogram)
+{
+    MetricHistogram histogram({ 1, 5, 10 });
+
+    for (const double value : { 0.5, 1.0, 3.0, 7.0, 100.0 }) {
+        histogram.observe(value);
+    }
+
+    const auto snapshot = histogram.snapshot();
+    ASSERT_EQ(snapshot.counts, (std::vector<uint64_t>{ 2, 3, 4, 5 }));
+    ASSERT_DOUBLE_EQ(snapshot.sum, 111.5);
+}
+
+TEST(NAME, test_write)
+{
+    auto& metrics = Metrics::instance();
+    metrics.counter("test_requests_total", "Requests.", "route=\"/a\"").add(3);
+    metrics.histogram("test_seconds", "Durations.", "", { 0.5 }).observe(0.25);
+
+    std::string out;
+    metrics.write(out);
+
+    ASSERT_NE(out.find("# HELP test_requests_total Requests.\n"
+                       "# TYPE test_requests_total counter\n"
+                       "test_requests_total{route=\"/a\"} 3\n"),
+              std::string::npos)
+      << out;
+    ASSERT_NE(out.find("# TYPE test_seconds histogram\n"
+                       "test_seconds_bucket{le=\"0.5\"} 1\n"
+                       "test_seconds_bucket{le=\"+Inf\"} 1\n"
+                       "test_seconds_sum 0.25\n"
+                       "test_seconds_count 1\n"),
+              std::string::npos)
+      << out;
+}
+
+TEST(NAME, test_help_kept)
+{
+    auto& metrics = Metrics::instance();
+    metrics.counter("test_help_total", "First help.", "a=\"1\"");
+    metrics.counter("test_help_total", "", "a=\"2\"");
+    metrics.histogram("test_help_seconds", "First help.", "a=\"1\"");
+    metrics.histogram("test_help_seconds", "Other help.", "a=\"1\"");
+
+    std::string out;
+    metrics.write(out);
+
+    ASSERT_NE(out.find("# HELP test_help_total First help.\n"),
+              std::string::npos)
+      << out;
+    ASSERT_NE(out.find("# HELP test_help_seconds First help.\n"),
+              std::string::npos)
+      << out;
+}
+
+TEST(NAME, test_database_statements)
+{
+    auto& selects = Metrics::instance().histogram(
+      "tasktracker_db_statement_seconds", "", "operation=\"select\"");
+    auto& inserts = Metrics::instance().histogram(
+      "tasktracker_db_statement_seconds", "", "operation=\"insert\"");
+    const auto selects_before = selects.snapshot().counts.back();
+    const auto inserts_before = inserts.snapshot().counts.back();
+
+    TaskDatabase db(TESTDBFILE);
+    db.init();
+    auto id = db.create_task("metrics task");
+    auto task = db.get_task(id);
+    db.delete_task(task.get());
+
+    ASSERT_GT(selects.snapshot().counts.back(), selects_before);
+    ASSERT_GT(inserts.snapshot().counts.back(), inserts_before);
+
+    // A bulk insert is counted per row, not as one execution.
+    std::vector<TaskInstanceData> instances(3);
+    for (size_t i = 0; i < instances.size(); ++i) {
+        instances[i].id = "metrics-" + std::to_string(i);
+        instances[i].parent_id = 1;
+        instances[i].name = "metrics task";
+    }
+    TaskInstanceDatabase instance_db(TESTDBFILE);
+    instance_db.init();
+    instance_db.clear();
+    const auto inserts_before_bulk = inserts.snapshot().counts.back();
+    instance_db.create_tasks(instances);
+    ASSERT_EQ(inserts.snapshot().counts.back(), inserts_before_bulk + 3);
+}
+
+int
+main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -206,6 +206,73 @@ TEST(NAME, test_occurs_interval)
     db.delete_task(task_data.get());
 }
 
+TEST(NAME, test_next_occurrence_matches_occurs)
+{
+    TaskDatabase db(TESTDBFILE);
+    auto uid = db.create_task(TESTTASKNAME);
+    auto task_data = db.get_task(uid);
+
+    tm start_tm{};
+    start_tm.tm_year = 2023 - 1900;
+    start_tm.tm_mday = 3;
+    start_tm.tm_hour = 9;
+    start_tm.tm_isdst = -1;
+    task_data->scheduled_start = mktime(&start_tm);
+
+    Task task(task_data.get(), &db);
+
+    const std::pair<RepeatType, int> rules[] = {
+        { RepeatType::NoRepeat, 0 },     { RepeatType::Monthly, 31 },
+        { RepeatType::Monthly, 12 },     { RepeatType::MonthlyDay, 23 },
+        { RepeatType::MonthlyDay, 47 },  { RepeatType::SpecifiedDays, 67 },
+        { RepeatType::SpecifiedDays, 2 }, { RepeatType::WithInterval, 5 },
+    };
+
+    for (const auto& [repeat_type, repeat_info] : rules) {
+        task_data->repeat_type = repeat_type;
+        task_data->repeat_info = repeat_info;
+
+        std::chrono::sys_days from =
+          std::chrono::year(2022) / std::chrono::December / 20;
+        const std::chrono::sys_days end = from + std::chrono::days(400);
+        std::chrono::sys_days expected = from;
+
+        while (from < end) {
+            while (expected < end) {
+                // Check at noon, so DST changes don't move the day.
+                std::chrono::year_month_day ymd{ expected };
+                tm day{};
+                day.tm_year = static_cast<int>(ymd.year()) - 1900;
+                day.tm_mon = static_cast<unsigned int>(ymd.month()) - 1;
+                day.tm_mday = static_cast<unsigned int>(ymd.day());
+                day.tm_hour = 12;
+                day.tm_isdst = -1;
+                mktime(&day);
+                if (task.occurs(day)) {
+                    break;
+                }
+                expected += std::chrono::days(1);
+            }
+
+            auto next = task.next_occurrence(from);
+            if (expected >= end) {
+                ASSERT_TRUE(!next || std::chrono::sys_days{ *next } >= end)
+                  << "type " << repeat_type << " info " << repeat_info;
+                break;
+            }
+            ASSERT_TRUE(next.has_value())
+              << "type " << repeat_type << " info " << repeat_info;
+            ASSERT_EQ(std::chrono::sys_days{ *next }, expected)
+              << "type " << repeat_type << " info " << repeat_info;
+
+            from = expected + std::chrono::days(1);
+            expected = from;
+        }
+    }
+
+    db.delete_task(task_data.get());
+}
+
 int
 main(int argc, char** argv)
 {
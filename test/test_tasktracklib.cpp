@@ -1,8 +1,12 @@
 #include <cassert>
+#include <chrono>
 #include <database_driver.h>
+#include <future>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <task_snapshot.h>
 #include <tasktracklib.h>
+#include <thread>
 
 #define NAME test_tasktracklib
 #define TESTDBFILE "test2.db"
@@ -264,6 +268,562 @@ TEST(NAME, test_task_lookup_performance)
     }
 }
 
+TEST(NAME, test_task_instance_cache)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2; // Monday january 2nd 2023
+    start_time.tm_hour = 9;
+
+    tracker.add_task(TESTTASKNAME2, RepeatType::SpecifiedDays, 1, start_time);
+    auto generation = tracker.generation();
+    auto tasks = tracker.get_task_instances(start_time);
+    ASSERT_EQ(tasks.size(), 1);
+    ASSERT_EQ(tracker.get_task_instances(start_time), tasks);
+    ASSERT_EQ(tracker.generation(), generation);
+
+    start_time.tm_hour = 8;
+    tracker.add_task(TESTTASKNAME, RepeatType::SpecifiedDays, 1, start_time);
+    ASSERT_GT(tracker.generation(), generation);
+    tasks = tracker.get_task_instances(start_time);
+    ASSERT_EQ(tasks.size(), 2);
+    ASSERT_EQ(tasks[0]->get_name(), TESTTASKNAME);
+
+    tracker.delete_task(tracker.get_tasks()[0]->get_id());
+    tasks = tracker.get_task_instances(start_time);
+    ASSERT_EQ(tasks.size(), 1);
+    ASSERT_EQ(tasks[0]->get_name(), TESTTASKNAME);
+
+    auto data = *tracker.get_tasks()[0]->get_data();
+    data.repeat_info = 2;
+    *tracker.get_tasks()[0]->get_data() = data;
+    tracker.modify_task(&data);
+    ASSERT_EQ(tracker.get_task_instances(start_time).size(), 0);
+
+    tracker.clear();
+    start_time = add_days(1, start_time);
+    ASSERT_EQ(tracker.get_task_instances(start_time).size(), 0);
+}
+
+TEST(NAME, test_catch_up)
+{
+    using namespace std::chrono;
+
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tracker.add_task(TESTTASKNAME,
+                     RepeatType::WithInterval,
+                     1,
+                     year(2023) / January / 1,
+                     hours(9),
+                     minutes(30));
+
+    ASSERT_EQ(tracker.catch_up(30, year(2023) / January / 5), 1)
+      << "Only today is processed on the first run.";
+    ASSERT_EQ(tracker.catch_up(30, year(2023) / January / 5), 0);
+    ASSERT_EQ(tracker.catch_up(30, year(2023) / January / 12), 7);
+    ASSERT_EQ(tracker.catch_up(3, year(2023) / February / 1), 4)
+      << "Days before the horizon are skipped.";
+
+    sqlite3* db = nullptr;
+    int count = 0;
+    ASSERT_EQ(sqlite3_open(TESTDBFILE, &db), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(
+                db,
+                "SELECT COUNT(*) FROM TASKINSTANCES;",
+                [](void* data, int, char** argv, char**) {
+                    *static_cast<int*>(data) = std::atoi(argv[0]);
+                    return 0;
+                },
+                &count,
+                NULL),
+              SQLITE_OK);
+    sqlite3_close(db);
+    ASSERT_EQ(count, 12);
+
+    TaskTracker other(TESTDBFILE);
+    auto tasks = other.get_task_instances(year(2023) / January / 8);
+    ASSERT_EQ(tasks.size(), 1);
+    time_t scheduled_time = tasks[0]->get_scheduled_datetime();
+    ASSERT_EQ(localtime(&scheduled_time)->tm_mday, 8);
+    ASSERT_EQ(localtime(&scheduled_time)->tm_hour, 9);
+    ASSERT_EQ(localtime(&scheduled_time)->tm_min, 30);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_task_instance_page)
+{
+    using namespace std::chrono;
+
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tracker.add_task(TESTTASKNAME,
+                     RepeatType::WithInterval,
+                     1,
+                     year(2023) / January / 1,
+                     hours(9),
+                     minutes(0));
+    tracker.add_task(TESTTASKNAME2,
+                     RepeatType::WithInterval,
+                     2,
+                     year(2023) / January / 1,
+                     hours(8),
+                     minutes(0));
+    tracker.catch_up(0, year(2023) / January / 1);
+    tracker.catch_up(30, year(2023) / January / 10);
+    tracker.get_task_instances(year(2023) / January / 3)[0]->finish_task();
+
+    tm from_tm{};
+    from_tm.tm_year = 2023 - 1900;
+    from_tm.tm_mday = 2;
+    from_tm.tm_isdst = -1;
+    time_t from = mktime(&from_tm);
+    time_t to = from + 7 * 24 * 60 * 60;
+
+    std::vector<std::unique_ptr<TaskInstanceData>> all;
+    while (true) {
+        auto page = tracker.get_task_instance_page(
+          from, to, std::nullopt, all.empty() ? nullptr : all.back().get(), 3);
+        if (page.empty()) {
+            break;
+        }
+        ASSERT_LE(page.size(), 3);
+        for (auto& item : page) {
+            all.push_back(std::move(item));
+        }
+    }
+
+    // 2.1.-8.1.: task every day, task2 on 3.1., 5.1. and 7.1.
+    ASSERT_EQ(all.size(), 10);
+    for (size_t i = 1; i < all.size(); ++i) {
+        ASSERT_LT(all[i - 1]->scheduled_start, all[i]->scheduled_start);
+    }
+
+    auto finished = tracker.get_task_instance_page(
+      from, to, TaskState::Finished, nullptr, 10);
+    ASSERT_EQ(finished.size(), 1);
+    ASSERT_EQ(finished[0]->name, TESTTASKNAME2);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_transaction)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 3;
+    start_time.tm_hour = 9;
+
+    int first_id = 0;
+    tracker.transaction([&]() {
+        for (int i = 0; i < 100; ++i) {
+            int id = tracker.add_task(
+              TESTTASKNAME, RepeatType::WithInterval, 2, start_time);
+            if (i == 0) {
+                first_id = id;
+            }
+        }
+        tracker.delete_task(first_id);
+    });
+    ASSERT_EQ(tracker.get_tasks().size(), 99);
+    ASSERT_EQ(TaskTracker(TESTDBFILE).get_tasks().size(), 99);
+
+    const auto failing = [&]() {
+        tracker.add_task(TESTTASKNAME2, RepeatType::NoRepeat, 0, start_time);
+        throw std::runtime_error("abort");
+    };
+    ASSERT_THROW(tracker.transaction(failing), std::runtime_error);
+    ASSERT_EQ(tracker.get_tasks().size(), 99)
+      << "The task added in the failed transaction must be rolled back.";
+    ASSERT_EQ(TaskTracker(TESTDBFILE).get_tasks().size(), 99);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_find_tasks)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2;
+    start_time.tm_hour = 9;
+
+    std::vector<int> interval_ids;
+    for (int i = 0; i < 10; ++i) {
+        const auto type =
+          i % 2 ? RepeatType::WithInterval : RepeatType::NoRepeat;
+        const int id = tracker.add_task(
+          i < 5 ? TESTTASKNAME : "other task", type, 1, start_time);
+        if (type == RepeatType::WithInterval) {
+            interval_ids.push_back(id);
+        }
+    }
+
+    auto tasks = tracker.find_tasks({}, 0, 4);
+    ASSERT_EQ(tasks.size(), 4);
+    tasks = tracker.find_tasks({}, tasks.back()->get_id(), 100);
+    ASSERT_EQ(tasks.size(), 6);
+
+    TaskFilter filter;
+    filter.repeat_type = RepeatType::WithInterval;
+    std::vector<int> ids;
+    int after = 0;
+    while (!(tasks = tracker.find_tasks(filter, after, 2)).empty()) {
+        for (const auto* task : tasks) {
+            ids.push_back(task->get_id());
+        }
+        after = tasks.back()->get_id();
+    }
+    ASSERT_EQ(ids, interval_ids);
+
+    filter.name_prefix = "test";
+    tasks = tracker.find_tasks(filter, 0, 100);
+    ASSERT_EQ(tasks.size(), 2);
+    for (const auto* task : tasks) {
+        ASSERT_EQ(task->get_name(), TESTTASKNAME);
+    }
+
+    tracker.delete_task(interval_ids[0]);
+    ASSERT_EQ(tracker.find_tasks(filter, 0, 100).size(), 1);
+    ASSERT_EQ(tracker.get_task(interval_ids[0]), nullptr);
+    ASSERT_NE(tracker.get_task(interval_ids[1]), nullptr);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_change_log)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2;
+    start_time.tm_hour = 9;
+
+    const uint64_t start = tracker.last_change_sequence();
+    const int id =
+      tracker.add_task(TESTTASKNAME, RepeatType::WithInterval, 1, start_time);
+    auto data = *tracker.get_task(id)->get_data();
+    data.name = TESTTASKNAME2;
+    tracker.modify_task(&data);
+    tracker.get_task_instances(start_time)[0]->finish_task();
+
+    auto changes = tracker.get_changes(start);
+    ASSERT_TRUE(changes);
+    ASSERT_EQ(changes->size(), 3);
+    ASSERT_EQ((*changes)[0].type, ChangeType::TaskCreated);
+    ASSERT_EQ((*changes)[0].task_id, id);
+    ASSERT_EQ((*changes)[1].type, ChangeType::TaskUpdated);
+    ASSERT_LT((*changes)[0].generation, (*changes)[1].generation);
+    ASSERT_EQ((*changes)[2].type, ChangeType::InstanceStateChanged);
+    ASSERT_EQ((*changes)[2].state, TaskState::Finished);
+    ASSERT_EQ((*changes)[2].instance_id,
+              tracker.get_task_instances(start_time)[0]->get_uid());
+    ASSERT_EQ((*changes)[2].sequence, tracker.last_change_sequence());
+    ASSERT_TRUE(tracker.get_changes(tracker.last_change_sequence())->empty());
+
+    // Changes by someone else show up after sync.
+    uint64_t seen = tracker.last_change_sequence();
+    TaskTracker other(TESTDBFILE);
+    other.delete_task(id);
+    ASSERT_TRUE(tracker.sync());
+    changes = tracker.get_changes(seen);
+    ASSERT_EQ(changes->size(), 1);
+    ASSERT_EQ((*changes)[0].type, ChangeType::TaskDeleted);
+    ASSERT_EQ((*changes)[0].generation, tracker.generation());
+
+    // Records of a rolled back transaction are dropped.
+    seen = tracker.last_change_sequence();
+    ASSERT_THROW(tracker.transaction([&]() {
+        tracker.add_task(TESTTASKNAME, RepeatType::NoRepeat, 0, start_time);
+        throw std::runtime_error("abort");
+    }),
+                 std::runtime_error);
+    ASSERT_EQ(tracker.last_change_sequence(), seen);
+
+    // A reader that fell too far behind has to start over.
+    tracker.transaction([&]() {
+        for (size_t i = 0; i < CHANGE_LOG_CAPACITY + 1; ++i) {
+            tracker.add_task(TESTTASKNAME, RepeatType::NoRepeat, 0, start_time);
+        }
+    });
+    ASSERT_FALSE(tracker.get_changes(seen));
+    changes = tracker.get_changes(seen + 1);
+    ASSERT_EQ(changes->size(), CHANGE_LOG_CAPACITY);
+    ASSERT_EQ(changes->back().sequence, tracker.last_change_sequence());
+
+    // Rolling back more records than the log holds overwrites the kept
+    // ones, but readers that are up to date can continue.
+    seen = tracker.last_change_sequence();
+    ASSERT_THROW(tracker.transaction([&]() {
+        for (size_t i = 0; i < CHANGE_LOG_CAPACITY + 1; ++i) {
+            tracker.add_task(TESTTASKNAME, RepeatType::NoRepeat, 0, start_time);
+        }
+        throw std::runtime_error("abort");
+    }),
+                 std::runtime_error);
+    ASSERT_EQ(tracker.last_change_sequence(), seen);
+    changes = tracker.get_changes(seen);
+    ASSERT_TRUE(changes);
+    ASSERT_TRUE(changes->empty());
+    ASSERT_FALSE(tracker.get_changes(seen - 1));
+    tracker.add_task(TESTTASKNAME, RepeatType::NoRepeat, 0, start_time);
+    changes = tracker.get_changes(seen);
+    ASSERT_EQ(changes->size(), 1);
+    ASSERT_EQ((*changes)[0].sequence, seen + 1);
+
+    tracker.clear();
+    changes = tracker.get_changes(tracker.last_change_sequence() - 1);
+    ASSERT_EQ(changes->back().type, ChangeType::Reset);
+}
+
+TEST(NAME, test_shared_between_threads)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2;
+    start_time.tm_hour = 9;
+
+    // An API thread hammers the tracker with writes while this thread reads
+    // the day like the UI does, taking the database lock first only when
+    // the day needs loading.
+    std::atomic<bool> done{ false };
+    std::thread writer([&]() {
+        for (int i = 0; i < 200; ++i) {
+            const int id = tracker.add_task(
+              TESTTASKNAME, RepeatType::WithInterval, 1, start_time);
+            if (i % 2) {
+                tracker.delete_task(id);
+            }
+        }
+        done = true;
+    });
+
+    while (!done) {
+        std::unique_lock<std::recursive_mutex> database;
+        auto lock = tracker.lock();
+        if (!tracker.is_day_loaded(start_time)) {
+            lock.unlock();
+            database = tracker.database_lock();
+            lock.lock();
+        }
+        for (const auto* instance : tracker.get_task_instances(start_time)) {
+            ASSERT_EQ(instance->get_name(), TESTTASKNAME);
+        }
+    }
+    writer.join();
+
+    ASSERT_EQ(tracker.get_tasks().size(), 100);
+    ASSERT_EQ(tracker.get_task_instances(start_time).size(), 100);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_read_during_transaction)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2;
+    start_time.tm_hour = 9;
+
+    tracker.add_task(TESTTASKNAME, RepeatType::WithInterval, 1, start_time);
+    tracker.get_task_instances(start_time);
+
+    // Another thread keeps a transaction open. Reading memory mustn't wait
+    // for it: if it did, the reader would never finish.
+    std::promise<void> opened;
+    std::promise<void> read;
+    std::thread writer([&]() {
+        tracker.transaction([&]() {
+            tracker.add_task(TESTTASKNAME2,
+                             RepeatType::NoRepeat,
+                             0,
+                             add_days(1, start_time));
+            opened.set_value();
+            read.get_future().wait();
+        });
+    });
+    opened.get_future().wait();
+
+    auto reader = std::async(std::launch::async, [&tracker, start_time]() {
+        const auto lock = tracker.lock();
+        if (!tracker.is_day_loaded(start_time)) {
+            return size_t{ 0 };
+        }
+        return tracker.get_tasks().size() +
+               tracker.get_task_instances(start_time).size();
+    });
+    const auto status = reader.wait_for(std::chrono::seconds(10));
+    read.set_value();
+    writer.join();
+
+    ASSERT_EQ(status, std::future_status::ready);
+    ASSERT_EQ(reader.get(), 3)
+      << "The uncommitted task is already loaded, the day isn't affected.";
+
+    tracker.clear();
+}
+
+TEST(NAME, test_upcoming)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 2; // Monday january 2nd 2023
+    start_time.tm_hour = 9;
+    start_time.tm_isdst = -1;
+
+    tracker.add_task(TESTTASKNAME, RepeatType::WithInterval, 2, start_time);
+    start_time.tm_hour = 8;
+    tracker.add_task(TESTTASKNAME2, RepeatType::SpecifiedDays, 3, start_time);
+    start_time.tm_hour = 9;
+    time_t after = mktime(&start_time);
+
+    auto task_id = tracker.get_tasks()[0]->get_id();
+    auto next = tracker.next_occurrence(task_id, after);
+    ASSERT_TRUE(next.has_value());
+    ASSERT_EQ(*next, after + 2 * 24 * 60 * 60)
+      << "The occurrence at the given time has already started.";
+    ASSERT_FALSE(tracker.next_occurrence(task_id + 100, after).has_value());
+
+    // 4.1. 8:00 task2, 4.1. 9:00 task, 6.1. 9:00 task, 8.1. 9:00 task,
+    // 10.1. 9:00 task, 11.1. 8:00 task2
+    auto occurrences = tracker.upcoming(6, after);
+    ASSERT_EQ(occurrences.size(), 6);
+    const char* names[] = { TESTTASKNAME2, TESTTASKNAME, TESTTASKNAME,
+                            TESTTASKNAME,  TESTTASKNAME, TESTTASKNAME2 };
+    for (size_t i = 0; i < occurrences.size(); ++i) {
+        ASSERT_EQ(occurrences[i].task->get_name(), names[i]);
+        if (i > 0) {
+            ASSERT_GT(occurrences[i].scheduled_start,
+                      occurrences[i - 1].scheduled_start);
+        }
+    }
+    time_t last = occurrences.back().scheduled_start;
+    ASSERT_EQ(localtime(&last)->tm_mday, 11);
+    ASSERT_EQ(localtime(&last)->tm_hour, 8);
+
+    tracker.clear();
+}
+
+TEST(NAME, test_sync_external_changes)
+{
+    TaskTracker tracker(TESTDBFILE);
+    tracker.clear();
+    TaskTracker other(TESTDBFILE);
+
+    tm start_time{};
+    start_time.tm_year = 2023 - 1900;
+    start_time.tm_mday = 3;
+    start_time.tm_hour = 9;
+
+    ASSERT_FALSE(other.has_external_changes());
+    ASSERT_FALSE(other.sync());
+
+    tracker.add_task(TESTTASKNAME, RepeatType::WithInterval, 1, start_time);
+    ASSERT_TRUE(other.has_external_changes());
+    ASSERT_TRUE(other.sync());
+    ASSERT_FALSE(other.has_external_changes());
+    ASSERT_EQ(other.get_tasks().size(), 1);
+    ASSERT_EQ(other.get_tasks()[0]->get_name(), TESTTASKNAME);
+
+    auto other_instances = other.get_task_instances(start_time);
+    ASSERT_EQ(other_instances.size(), 1);
+    ASSERT_FALSE(tracker.sync())
+      << "Creating a task instance doesn't change loaded data.";
+
+    auto instances = tracker.get_task_instances(start_time);
+    ASSERT_EQ(instances.size(), 1);
+    instances[0]->finish_task();
+    ASSERT_TRUE(other.sync());
+    ASSERT_TRUE(other_instances[0]->is_finished());
+
+    auto data = *tracker.get_tasks()[0]->get_data();
+    data.name = TESTTASKNAME2;
+    tracker.modify_task(&data);
+    ASSERT_TRUE(other.sync());
+    ASSERT_EQ(other.get_tasks()[0]->get_name(), TESTTASKNAME2);
+
+    other.add_task(TESTTASKNAME, RepeatType::NoRepeat, 0, start_time);
+    ASSERT_FALSE(other.sync()) << "Own changes are already loaded.";
+    ASSERT_TRUE(tracker.sync());
+    ASSERT_EQ(tracker.get_tasks().size(), 2);
+
+    tracker.delete_task(tracker.get_tasks()[0]->get_id());
+    ASSERT_TRUE(other.sync());
+    ASSERT_EQ(other.get_tasks().size(), 1);
+    ASSERT_EQ(other.get_tasks()[0]->get_name(), TESTTASKNAME);
+
+    tracker.clear();
+    ASSERT_TRUE(other.sync());
+    ASSERT_EQ(other.get_tasks().size(), 0);
+}
+
+TEST(NAME, test_snapshot_startup)
+{
+    const int task_count = 20;
+    {
+        TaskTracker tracker(TESTDBFILE);
+        tracker.clear();
+        tracker.transaction([&tracker]() {
+            for (int i = 0; i < task_count; ++i) {
+                tracker.add_task(TESTTASKNAME + std::to_string(i),
+                                 RepeatType::WithInterval,
+                                 i % 7 + 1,
+                                 time_t(1672531200 + i));
+            }
+        });
+        ASSERT_TRUE(tracker.save_snapshot());
+
+        TaskTracker warm(TESTDBFILE);
+        ASSERT_EQ(warm.get_tasks().size(), task_count);
+        for (const auto* task : tracker.get_tasks()) {
+            ASSERT_EQ(*warm.get_task(task->get_id())->get_data(),
+                      *task->get_data());
+        }
+    }
+
+    // Tell the snapshot apart from the database to see that it's read.
+    const long long change = TaskDatabase(TESTDBFILE).last_change();
+    TaskData data{};
+    data.id = 1;
+    data.name = "from snapshot";
+    ASSERT_TRUE(write_task_snapshot(TESTDBFILE ".snapshot", change, { &data }));
+    {
+        TaskTracker tracker(TESTDBFILE);
+        ASSERT_EQ(tracker.get_tasks().size(), 1);
+        ASSERT_EQ(tracker.get_tasks().front()->get_name(), "from snapshot");
+    }
+
+    TaskDatabase(TESTDBFILE).create_task(TESTTASKNAME);
+    TaskTracker after_change(TESTDBFILE);
+    ASSERT_EQ(after_change.get_tasks().size(), task_count + 1)
+      << "Snapshot must not be used after the database changed.";
+
+    after_change.clear();
+    std::filesystem::remove(TESTDBFILE ".snapshot");
+}
+
 int
 main(int argc, char** argv)
 {